@@ -0,0 +1,296 @@
+/*
+ *     lin.c
+ *
+ *          Description:  LIN 2.x frame engine on top of the UART library
+ *          Author:       Hans-Henrik Fuxelius
+ *          Date:         Uppsala, 2023-05-29
+ *          License:      MIT
+ *          Version:      RC1
+ */
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "uart.h"
+#include "lin.h"
+
+#ifdef USART_LIN
+
+#define LIN_SYNC            0x55
+#define LIN_RX_ERROR_MASK   (USART_FERR_bm | USART_PERR_bm | USART_BUFOVF_bm)
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// FRAME ENGINE STATES
+#define LIN_IDLE            0
+#define LIN_BREAK           1               // Master: break sent, waiting for its echo
+#define LIN_SYNC_FIELD      2               // Master: sync sent, waiting for its echo
+#define LIN_PID             3               // Master: PID sent, waiting for its echo
+#define LIN_TX_DATA         4               // Response byte sent, waiting for its echo
+#define LIN_RX_DATA         5               // Receiving response
+#define LIN_HDR_SYNC        6               // Slave: break read as data, expecting sync
+#define LIN_HDR_PID         7               // Slave: break + sync done, expecting the PID
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// HELPER FUNCTIONS
+uint8_t lin_pid(uint8_t id) {
+    id &= 0x3F;
+    uint8_t p0 = ((id >> 0) ^ (id >> 1) ^ (id >> 2) ^ (id >> 4)) & 0x01;
+    uint8_t p1 = ~((id >> 1) ^ (id >> 3) ^ (id >> 4) ^ (id >> 5)) & 0x01;
+    return id | (p0 << 6) | (p1 << 7);
+}
+
+static inline uint16_t lin_sum(uint16_t sum, uint8_t byte) {
+    sum += byte;
+    if (sum > 0xFF) {
+        sum -= 0xFF;                                        // Sum with carry wrap-around
+    }
+    return sum;
+}
+
+static lin_frame_t* lin_find(lin_t* lin, uint8_t id) {
+    for (uint8_t i = 0; i < lin->frame_count; i++) {
+        if (lin->frames[i].id == id) {
+            return &lin->frames[i];
+        }
+    }
+    return NULL;
+}
+
+static inline void lin_put(lin_t* lin, uint8_t byte) {
+    lin->meta->usart->STATUS = USART_TXCIF_bm;
+    lin->meta->usart->TXDATAL = byte;
+    lin->tx_byte = byte;
+}
+
+static void lin_finish(lin_t* lin, uint8_t status) {
+    if (lin->frame) {
+        lin->frame->status = status;
+    }
+    lin->frame = NULL;
+    lin->state = LIN_IDLE;
+}
+
+// Next response byte; the checksum follows the last data byte
+static void lin_tx_next(lin_t* lin) {
+    uint8_t byte;
+    if (lin->index < lin->frame->length) {
+        byte = lin->frame->data[lin->index];
+        lin->sum = lin_sum(lin->sum, byte);
+    }
+    else {
+        byte = ~(uint8_t)lin->sum;
+    }
+    lin->index++;
+    lin_put(lin, byte);
+}
+
+// Header complete; publish or subscribe if this node owns the frame
+static void lin_header_done(lin_t* lin, uint8_t pid) {
+    if (lin->state != LIN_IDLE) {
+        lin_finish(lin, LIN_FRAME_NO_RESPONSE);
+    }
+    lin_frame_t* frame = lin_find(lin, pid & 0x3F);
+    lin->state = LIN_IDLE;
+    if (!frame || (pid != lin_pid(pid))) {                  // Not ours, or PID parity error
+        lin->frame = NULL;
+        return;
+    }
+    lin->frame = frame;
+    lin->pid = pid;
+    lin->index = 0;
+    lin->sum = (frame->checksum == LIN_ENHANCED) ? pid : 0;
+    if (frame->direction == LIN_PUBLISH) {
+        lin->state = LIN_TX_DATA;
+        lin_tx_next(lin);
+    }
+    else {
+        lin->state = LIN_RX_DATA;
+    }
+}
+
+// Slave header, one byte at a time: break -> sync -> PID. The break is either read as a
+// 0x00 with framing error, or reported by auto-baud (brk) on the byte after the sync field,
+// which is the sync echo (0x55) if the hardware passes it on, else the PID itself.
+// A PID of 0x55 (ID 0x15) on a brk byte is therefore taken as the sync echo.
+// Returns false for bytes that are not part of a header
+static bool lin_slave_header(lin_t* lin, uint8_t status, uint8_t byte, bool brk) {
+    bool ok = !(status & LIN_RX_ERROR_MASK);
+    if ((byte == 0x00) && (status & USART_FERR_bm)) {       // Break; drop any frame in progress
+        lin_finish(lin, LIN_FRAME_NO_RESPONSE);
+        lin->state = LIN_HDR_SYNC;
+        return true;
+    }
+    switch (lin->state) {
+        case LIN_HDR_SYNC:
+            if (ok && (byte == LIN_SYNC)) {
+                lin->state = LIN_HDR_PID;
+            }
+            else if (ok && brk) {                           // Sync swallowed by auto-baud
+                lin_header_done(lin, byte);
+            }
+            else {
+                lin->state = LIN_IDLE;
+            }
+            return true;
+        case LIN_HDR_PID:                                   // Exactly one byte after the sync
+            if (ok) {
+                lin_header_done(lin, byte);
+            }
+            else {
+                lin->state = LIN_IDLE;
+            }
+            return true;
+        default:
+            break;
+    }
+    if (!brk) {
+        return false;
+    }
+    lin_finish(lin, LIN_FRAME_NO_RESPONSE);
+    if (!ok) {
+        lin->state = LIN_IDLE;
+    }
+    else if (byte == LIN_SYNC) {                            // Sync echo; PID is next
+        lin->state = LIN_HDR_PID;
+    }
+    else {
+        lin_header_done(lin, byte);
+    }
+    return true;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// LIN FUNCTIONS
+// Call after usart_init(); a slave resynchronizes on every break + sync (LINAUTO)
+void lin_init(lin_t* lin, volatile usart_meta_t* meta, uint8_t mode, lin_frame_t* frames, uint8_t frame_count) {
+    lin->meta = meta;
+    lin->mode = mode;
+    lin->frames = frames;
+    lin->frame_count = frame_count;
+    lin->schedule = NULL;
+    lin->schedule_len = 0;
+    lin->slot = 0;
+    lin->ticks_left = 0;
+    lin->frame = NULL;
+    lin->state = LIN_IDLE;
+    lin->baud = meta->usart->BAUD;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        meta->lin = lin;
+    }
+    if (mode == LIN_SLAVE) {
+        usart_autobaud(meta, USART_RXMODE_LINAUTO_gc);
+    }
+}
+
+void lin_schedule(lin_t* lin, const lin_slot_t* schedule, uint8_t schedule_len) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        lin->schedule = schedule;
+        lin->schedule_len = schedule_len;
+        lin->slot = 0;
+        lin->ticks_left = 0;
+    }
+}
+
+// Master: call from a periodic timer ISR; sends the next header when a slot ends
+void lin_tick(lin_t* lin) {
+    if ((lin->mode != LIN_MASTER) || !lin->schedule_len) {
+        return;
+    }
+    if (lin->ticks_left && --lin->ticks_left) {
+        return;
+    }
+    const lin_slot_t* slot = &lin->schedule[lin->slot];
+    lin->slot = (lin->slot + 1 < lin->schedule_len) ? lin->slot + 1 : 0;
+    lin->ticks_left = slot->ticks;
+    lin_send_header(lin, slot->frame);
+}
+
+// Master: break is a 0x00 sent at 2/3 of the bit rate, i.e. 13.5 nominal bits low
+void lin_send_header(lin_t* lin, uint8_t frame) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (lin->state != LIN_IDLE) {
+            lin_finish(lin, LIN_FRAME_NO_RESPONSE);         // Previous slot timed out
+        }
+        lin->frame = &lin->frames[frame];
+        lin->pid = lin_pid(lin->frame->id);
+        lin->state = LIN_BREAK;
+        lin->meta->usart->BAUD = lin->baud + (lin->baud >> 1);
+        lin_put(lin, 0x00);
+    }
+}
+
+// True while a header or response is on the bus; BAUD may then be the break rate
+bool lin_busy(lin_t* lin) {
+    return (lin->state != LIN_IDLE);
+}
+
+void lin_stop(lin_t* lin) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        lin->meta->lin = NULL;
+        lin->meta->usart->BAUD = lin->baud;
+        lin->schedule_len = 0;
+        lin->frame = NULL;
+        lin->state = LIN_IDLE;
+    }
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// ISR FUNCTION; CALLED FROM THE USART Rx ISR FOR EVERY BYTE (INCLUDING OWN ECHO)
+void lin_isr_rxc(lin_t* lin, uint8_t status, char data, bool brk) {
+    uint8_t byte = (uint8_t)data;
+    if ((lin->mode == LIN_SLAVE) && lin_slave_header(lin, status, byte, brk)) {
+        return;
+    }
+    switch (lin->state) {
+        case LIN_BREAK:
+            while (!(lin->meta->usart->STATUS & USART_TXCIF_bm));   // Delimiter out before BAUD changes
+            lin->meta->usart->BAUD = lin->baud;
+            lin_put(lin, LIN_SYNC);
+            lin->state = LIN_SYNC_FIELD;
+            break;
+        case LIN_SYNC_FIELD:
+            if ((byte != LIN_SYNC) || (status & LIN_RX_ERROR_MASK)) {
+                lin_finish(lin, LIN_FRAME_BIT_ERROR);
+                break;
+            }
+            lin_put(lin, lin->pid);
+            lin->state = LIN_PID;
+            break;
+        case LIN_PID:
+            if ((byte != lin->pid) || (status & LIN_RX_ERROR_MASK)) {
+                lin_finish(lin, LIN_FRAME_BIT_ERROR);
+                break;
+            }
+            lin->state = LIN_IDLE;
+            lin_header_done(lin, byte);
+            break;
+        case LIN_TX_DATA:
+            if ((byte != lin->tx_byte) || (status & LIN_RX_ERROR_MASK)) {
+                lin_finish(lin, LIN_FRAME_BIT_ERROR);
+            }
+            else if (lin->index > lin->frame->length) {     // Checksum echoed
+                lin_finish(lin, LIN_FRAME_OK);
+            }
+            else {
+                lin_tx_next(lin);
+            }
+            break;
+        case LIN_RX_DATA:
+            if (status & LIN_RX_ERROR_MASK) {
+                lin_finish(lin, LIN_FRAME_BIT_ERROR);
+            }
+            else if (lin->index < lin->frame->length) {
+                lin->frame->data[lin->index++] = byte;
+                lin->sum = lin_sum(lin->sum, byte);
+            }
+            else {
+                lin_finish(lin, (byte == (uint8_t)~lin->sum) ? LIN_FRAME_OK : LIN_FRAME_CHECKSUM);
+            }
+            break;
+        default:                                            // Idle; not our frame
+            break;
+    }
+}
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ *     lin.h
+ *
+ *          Description:  LIN 2.x frame engine on top of the UART library
+ *          Author:       Hans-Henrik Fuxelius
+ *          Date:         Uppsala, 2023-05-29
+ *          License:      MIT
+ *          Version:      RC1
+ */
+
+#ifndef LIN_H
+#define LIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uart.h"
+
+#ifdef USART_LIN
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+#define LIN_MASTER              0
+#define LIN_SLAVE               1
+
+#define LIN_CLASSIC             0           // Checksum over data only (LIN 1.x)
+#define LIN_ENHANCED            1           // Checksum over PID and data (LIN 2.x)
+
+#define LIN_PUBLISH             0           // This node sends the response
+#define LIN_SUBSCRIBE           1           // This node receives the response
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// FRAME STATUS
+#define LIN_FRAME_NONE          0
+#define LIN_FRAME_OK            1           // Response sent or received
+#define LIN_FRAME_CHECKSUM      2           // Received checksum mismatch
+#define LIN_FRAME_BIT_ERROR     3           // Echo mismatch or frame error
+#define LIN_FRAME_NO_RESPONSE   4           // Slot ended before the response was complete
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// FRAME STRUCT; ONE PER FRAME ID THIS NODE PUBLISHES OR SUBSCRIBES TO
+typedef struct {
+    uint8_t id;                     // Frame ID 0 - 63
+    uint8_t length;                 // Data bytes 1 - 8
+    uint8_t direction;              // LIN_PUBLISH or LIN_SUBSCRIBE
+    uint8_t checksum;               // LIN_CLASSIC or LIN_ENHANCED
+    volatile uint8_t data[8];       // Response data
+    volatile uint8_t status;        // LIN_FRAME_*, updated from ISR
+} lin_frame_t;
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// SCHEDULE TABLE SLOT (MASTER)
+typedef struct {
+    uint8_t frame;                  // Index into frame table
+    uint8_t ticks;                  // Slot length in lin_tick() calls
+} lin_slot_t;
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// LIN STRUCT
+typedef struct lin {
+    volatile usart_meta_t* meta;    // USART used for the bus
+    uint8_t mode;                   // LIN_MASTER or LIN_SLAVE
+    lin_frame_t* frames;            // Frame table
+    uint8_t frame_count;
+    const lin_slot_t* schedule;     // Schedule table (master)
+    uint8_t schedule_len;
+    uint8_t slot;                   // Next schedule slot
+    uint8_t ticks_left;             // Ticks left in current slot
+    uint16_t baud;                  // Nominal BAUD register value
+    volatile uint8_t state;         // Frame engine state
+    lin_frame_t* frame;             // Frame in progress
+    uint8_t pid;                    // PID of frame in progress
+    uint8_t index;                  // Next data byte
+    uint16_t sum;                   // Running checksum
+    uint8_t tx_byte;                // Last byte sent, compared to its echo
+} lin_t;
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// LIN FUNCTIONS
+void lin_init(lin_t* lin, volatile usart_meta_t* meta, uint8_t mode, lin_frame_t* frames, uint8_t frame_count);
+void lin_schedule(lin_t* lin, const lin_slot_t* schedule, uint8_t schedule_len);
+void lin_tick(lin_t* lin);
+void lin_send_header(lin_t* lin, uint8_t frame);
+void lin_stop(lin_t* lin);
+bool lin_busy(lin_t* lin);
+uint8_t lin_pid(uint8_t id);
+void lin_isr_rxc(lin_t* lin, uint8_t status, char data, bool brk);
+
+#endif
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ *     rbuffer.h
+ *
+ *          Description:  Lock-free SPSC ring buffer for the UART library
+ *          Author:       Hans-Henrik Fuxelius
+ *          Date:         Uppsala, 2023-05-29
+ *          License:      MIT
+ *          Version:      RC1
+ */
+
+#ifndef RBUFFER_H
+#define RBUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <util/atomic.h>
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// INDEX WIDTH; RBUFFER_INDEX16 IS SET IN (OR DERIVED BY) uart.h BEFORE INCLUDING
+#ifdef RBUFFER_INDEX16
+typedef uint16_t rbuffer_index_t;
+#else
+typedef uint8_t rbuffer_index_t;
+#endif
+
+// Largest size whose count (in - out) still fits the index: 128 or 32768
+#define RBUFFER_SIZE_MAX ((uint16_t)(rbuffer_index_t)~0 / 2 + 1)
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// RINGBUFFER STRUCT (SPSC; 'in' owned by producer, 'out' owned by consumer)
+typedef struct { 
+    volatile char*           buffer;    // Storage, size is (mask + 1)
+    rbuffer_index_t          mask;      // Size - 1; size MUST be a power of 2
+    volatile rbuffer_index_t in;
+    volatile rbuffer_index_t out;
+} ringbuffer_t;
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// RINGBUFFER FUNCTIONS
+// SPSC: producer only writes 'in', consumer only writes 'out'. Indices run free
+// and wrap at 2^n, so count = in - out and no shared counter is needed. 8-bit
+// indices are accessed atomically by the CPU; 16-bit ones need a short guard.
+#ifdef RBUFFER_INDEX16
+    #define RBUFFER_GUARD() ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+    #define RBUFFER_GUARD()
+#endif
+
+// Storage size check for rings bound at run time; a power of 2 from 2 to RBUFFER_SIZE_MAX
+static inline bool rbuffer_size_ok(uint16_t size) {
+    return ((size >= 2) && (size <= RBUFFER_SIZE_MAX) && !(size & (size - 1)));
+}
+
+static inline void rbuffer_init(volatile ringbuffer_t* rb) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        rb->in = 0;
+        rb->out = 0;
+    }
+}
+
+static inline rbuffer_index_t rbuffer_count(volatile ringbuffer_t* rb) {
+    rbuffer_index_t count;
+    RBUFFER_GUARD() {
+        count = (rbuffer_index_t)(rb->in - rb->out);
+    }
+    return count;
+}
+
+static inline bool rbuffer_full(volatile ringbuffer_t* rb) {
+    return (rbuffer_count(rb) > rb->mask);
+}
+
+static inline bool rbuffer_empty(volatile ringbuffer_t* rb) {
+    return (rbuffer_count(rb) == 0);
+}
+
+static inline void rbuffer_insert(char data, volatile ringbuffer_t* rb) {   
+    rbuffer_index_t in = rb->in;
+    *(rb->buffer + (in & rb->mask)) = data;
+    RBUFFER_GUARD() {
+        rb->in = in + 1;                                    // Publish AFTER data is stored
+    }
+}
+
+static inline char rbuffer_remove(volatile ringbuffer_t* rb) {
+    rbuffer_index_t out = rb->out;
+    char data = *(rb->buffer + (out & rb->mask));
+    RBUFFER_GUARD() {
+        rb->out = out + 1;                                  // Release AFTER data is read
+    }
+    return data;
+}
+
+// Contiguous readable region from 'out'; stable until consumed (producer never writes it)
+static inline rbuffer_index_t rbuffer_peek(volatile ringbuffer_t* rb, const char** data) {
+    rbuffer_index_t count = rbuffer_count(rb);
+    rbuffer_index_t out = rb->out & rb->mask;
+    rbuffer_index_t linear = rb->mask - out + 1;            // Bytes up to end of storage
+    *data = (const char*)(rb->buffer + out);
+    return (count < linear) ? count : linear;
+}
+
+static inline void rbuffer_consume(volatile ringbuffer_t* rb, rbuffer_index_t n) {
+    rbuffer_index_t out = rb->out + n;
+    RBUFFER_GUARD() {
+        rb->out = out;
+    }
+}
+
+// Contiguous writable region from 'in'; private to the producer until committed
+static inline rbuffer_index_t rbuffer_reserve(volatile ringbuffer_t* rb, char** data) {
+    rbuffer_index_t space = rb->mask - rbuffer_count(rb) + 1;
+    rbuffer_index_t in = rb->in & rb->mask;
+    rbuffer_index_t linear = rb->mask - in + 1;             // Bytes up to end of storage
+    *data = (char*)(rb->buffer + in);
+    return (space < linear) ? space : linear;
+}
+
+static inline void rbuffer_commit(volatile ringbuffer_t* rb, rbuffer_index_t n) {
+    rbuffer_index_t in = rb->in + n;
+    RBUFFER_GUARD() {
+        rb->in = in;
+    }
+}
+
+#endif
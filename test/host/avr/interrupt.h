@@ -0,0 +1,15 @@
+/*
+ *     test/host/avr/interrupt.h
+ *
+ *          Description:  Host stand-in for avr-libc <avr/interrupt.h>
+ *          License:      MIT
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#define ISR(vector)         void vector(void); void vector(void)
+#define sei()
+#define cli()
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ *     test/host/avr/io.h
+ *
+ *          Description:  Host stand-in for avr-libc <avr/io.h> (ATmega4808 register map)
+ *          License:      MIT
+ */
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+// Register types and bit masks only; tests never touch the fixed I/O addresses
+#define _SFR_MEM8(addr)     (*(volatile uint8_t*)(uintptr_t)(addr))
+#define _SFR_MEM16(addr)    (*(volatile uint16_t*)(uintptr_t)(addr))
+#define _SFR_MEM32(addr)    (*(volatile uint32_t*)(uintptr_t)(addr))
+#define _VECTOR(n)          __vector_ ## n
+#define _BV(bit)            (1 << (bit))
+#define _AVR_IO_H_
+#include "../../../doc/iom4808.h"
+
+#define _PROTECTED_WRITE(reg, value)    ((reg) = (value))
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ *     test/host/avr/pgmspace.h
+ *
+ *          Description:  Host stand-in for avr-libc <avr/pgmspace.h>
+ *          License:      MIT
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+
+// Flash and RAM share one address space on the host
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ *     test/host/avr/sleep.h
+ *
+ *          Description:  Host stand-in for avr-libc <avr/sleep.h>
+ *          License:      MIT
+ */
+
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#define sleep_cpu()
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ *     test/host/util/atomic.h
+ *
+ *          Description:  Host stand-in for avr-libc <util/atomic.h>
+ *          License:      MIT
+ */
+
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+#include <avr/interrupt.h>                  // As avr-libc; sei() and cli()
+
+// A single aligned 8/16-bit index store is already atomic on the host
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (int atomic_once_ = 1; atomic_once_; atomic_once_ = 0)
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ *     test/lin_header.c
+ *
+ *          Description:  Host test of the LIN slave header sequencing in lin.c (make test)
+ *          License:      MIT
+ *
+ *  Feeds lin_isr_rxc() the byte sequences a slave may see for one header, depending on
+ *  whether the USART passes the break and the sync field on as data, and on whether the
+ *  auto-baud measurement is reported (brk) with the sync echo or with the PID. Each
+ *  header is followed by a response, so a header that is dropped or taken from the
+ *  wrong byte shows up in the frame status. The USART is a plain struct in RAM.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "lin.h"
+
+#define ID_RX       0x10                    // Subscribed frame
+#define ID_TX       0x22                    // Published frame
+#define ID_OTHER    0x05                    // Frame of another node
+#define SYNC        0x55
+#define BRK         true
+
+static USART_t usart_fake;
+static usart_meta_t meta = {.usart = &usart_fake};
+static lin_frame_t frames[] = {
+    {.id = ID_RX, .length = 2, .direction = LIN_SUBSCRIBE, .checksum = LIN_ENHANCED},
+    {.id = ID_TX, .length = 3, .direction = LIN_PUBLISH, .checksum = LIN_CLASSIC, .data = {0xA1, 0xB2, 0xC3}},
+};
+static lin_t lin;
+static int failures;
+
+// Called by lin_init() for a slave; the USART is not real here
+void usart_autobaud(volatile usart_meta_t* m, uint8_t rxmode_gc) {
+    (void)m;
+    (void)rxmode_gc;
+}
+
+static uint8_t checksum(uint16_t sum, const uint8_t* data, uint8_t length) {
+    for (uint8_t i = 0; i < length; i++) {
+        sum += data[i];
+        if (sum > 0xFF) {
+            sum -= 0xFF;
+        }
+    }
+    return ~(uint8_t)sum;
+}
+
+static void rx(uint8_t status, uint8_t byte, bool brk) {
+    lin_isr_rxc(&lin, status, (char)byte, brk);
+}
+
+// Master's response to the subscribed frame
+static void response_rx(void) {
+    const uint8_t data[2] = {0x12, 0x34};
+    rx(0, data[0], false);
+    rx(0, data[1], false);
+    rx(0, checksum(lin_pid(ID_RX), data, 2), false);
+}
+
+// Own response to the published frame, echoed back by the bus
+static void response_tx(void) {
+    for (uint8_t i = 0; i < 5 && lin_busy(&lin); i++) {
+        rx(0, usart_fake.TXDATAL, false);
+    }
+}
+
+static void expect(const char* name, uint8_t index, uint8_t status) {
+    if (frames[index].status != status) {
+        fprintf(stderr, "%s: frame %u status %u, expected %u\n", name, index, frames[index].status, status);
+        failures++;
+    }
+    if (lin_busy(&lin)) {
+        fprintf(stderr, "%s: engine not idle after the frame\n", name);
+        failures++;
+    }
+    frames[0].status = LIN_FRAME_NONE;
+    frames[1].status = LIN_FRAME_NONE;
+}
+
+int main(void) {
+    lin_init(&lin, &meta, LIN_SLAVE, frames, 2);
+
+    // Break read as 0x00 with framing error, sync and PID as data
+    rx(USART_FERR_bm, 0x00, false);
+    rx(0, SYNC, false);
+    rx(0, lin_pid(ID_RX), false);
+    response_rx();
+    expect("break, sync, PID", 0, LIN_FRAME_OK);
+
+    // Same, with the measurement reported on the sync echo
+    rx(USART_FERR_bm, 0x00, false);
+    rx(0, SYNC, BRK);
+    rx(0, lin_pid(ID_RX), false);
+    response_rx();
+    expect("break, sync + brk, PID", 0, LIN_FRAME_OK);
+
+    // Break as data, sync swallowed by auto-baud; the measurement comes with the PID
+    rx(USART_FERR_bm, 0x00, false);
+    rx(0, lin_pid(ID_RX), BRK);
+    response_rx();
+    expect("break, PID + brk", 0, LIN_FRAME_OK);
+
+    // Neither break nor sync as data; same header twice (unchanged BAUD)
+    for (uint8_t i = 0; i < 2; i++) {
+        rx(0, lin_pid(ID_RX), BRK);
+        response_rx();
+        expect("PID + brk", 0, LIN_FRAME_OK);
+    }
+
+    // Only the sync echo comes with the measurement
+    rx(0, SYNC, BRK);
+    rx(0, lin_pid(ID_RX), false);
+    response_rx();
+    expect("sync + brk, PID", 0, LIN_FRAME_OK);
+
+    // Published frame
+    rx(0, lin_pid(ID_TX), BRK);
+    response_tx();
+    expect("publish", 1, LIN_FRAME_OK);
+
+    // Bytes without a header, and frames of other nodes, are ignored
+    rx(0, lin_pid(ID_RX), false);
+    response_rx();
+    rx(0, lin_pid(ID_OTHER), BRK);
+    response_rx();
+    expect("no header", 0, LIN_FRAME_NONE);
+
+    // PID parity error, and a framing error in place of the PID
+    rx(0, lin_pid(ID_RX) ^ 0x80, BRK);
+    response_rx();
+    expect("PID parity", 0, LIN_FRAME_NONE);
+    rx(USART_FERR_bm, 0x00, false);
+    rx(0, SYNC, false);
+    rx(USART_FERR_bm, lin_pid(ID_RX), false);
+    response_rx();
+    expect("PID framing error", 0, LIN_FRAME_NONE);
+
+    // A new break cuts short a response in progress
+    rx(0, lin_pid(ID_RX), BRK);
+    rx(0, 0x12, false);
+    rx(USART_FERR_bm, 0x00, false);
+    if (frames[0].status != LIN_FRAME_NO_RESPONSE) {
+        fprintf(stderr, "break in response: status %u\n", frames[0].status);
+        failures++;
+    }
+    rx(0, SYNC, false);
+    rx(0, lin_pid(ID_RX), false);
+    response_rx();
+    expect("header after cut", 0, LIN_FRAME_OK);
+
+    if (failures) {
+        return 1;
+    }
+    printf("lin_header: slave header sequences ok\n");
+    return 0;
+}
@@ -10,88 +10,231 @@
 
 #include <avr/io.h>
 #include <avr/pgmspace.h>
+#include <avr/sleep.h>
 #include <util/atomic.h>
-#include <util/delay.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include "uart.h"
+#include "lin.h"
 
 #define USART_RX_ERROR_MASK (USART_BUFOVF_bm | USART_FERR_bm | USART_PERR_bm) // [Datasheet ss. 295]
 
-// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
-// RINGBUFFER FUNCTIONS
-void rbuffer_init(volatile ringbuffer_t* rb) {
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        rb->in = 0;
-        rb->out = 0;
-        rb->count = 0;
-    }
-}
-
-uint8_t rbuffer_count(volatile ringbuffer_t* rb) {
-    return rb->count;
-}
-
-bool rbuffer_full(volatile ringbuffer_t* rb) {
-    return (rb->count == (uint8_t)RBUFFER_SIZE);
-}
-
-bool rbuffer_empty(volatile ringbuffer_t* rb) {
-    return (rb->count == 0);
-}
-
-void rbuffer_insert(char data, volatile ringbuffer_t* rb) {   
-    *(rb->buffer + rb->in) = data;
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        rb->in = (rb->in + 1) & ((uint8_t)RBUFFER_SIZE - 1);
-        rb->count++;
-    }
-}
-
-char rbuffer_remove(volatile ringbuffer_t* rb) {
-    char data = *(rb->buffer + rb->out);
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        rb->out = (rb->out + 1) & ((uint8_t)RBUFFER_SIZE - 1);
-        rb->count--;
-    }
-    return data;
-}
+// Per-byte Rx status nibble: PERR, FERR keep their RXDATAH position, BUFOVF moves to bit 3
+#define USART_RX_STATUS_PACK(rxdatah) (((rxdatah) & (USART_FERR_bm | USART_PERR_bm)) | (((rxdatah) & USART_BUFOVF_bm) >> 3))
+#define USART_RX_STATUS_UNPACK(nibble) ((uint16_t)(((nibble) & (USART_FERR_bm | USART_PERR_bm)) | (((nibble) & 0x08) << 3)) << 8)
 
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 // VARIABLES
+#define RBUFFER_STATIC(storage, size) {.buffer = (size) ? (storage) : NULL, .mask = (size) ? (size) - 1 : 0}
+#define RX_STATUS_STATIC(storage, size) ((size) ? (storage) : NULL)
+
 #ifdef USART0_ENABLE
-volatile usart_meta_t usart0 = {.usart = &USART0, .pmuxr = &PORTMUX.USARTROUTEA};
+static volatile char usart0_rx_buffer[USART0_RX_BUFFER_SIZE];
+static volatile uint8_t usart0_rx_status[USART_RX_STATUS_SIZE(USART0_RX_BUFFER_SIZE)];
+static volatile char usart0_tx_buffer[USART0_TX_BUFFER_SIZE];
+volatile usart_meta_t usart0 = {.usart = &USART0, .pmuxr = &PORTMUX.USARTROUTEA,
+                                 .rb_rx = RBUFFER_STATIC(usart0_rx_buffer, USART0_RX_BUFFER_SIZE),
+                                 .rb_tx = RBUFFER_STATIC(usart0_tx_buffer, USART0_TX_BUFFER_SIZE),
+                                 .rx_status = RX_STATUS_STATIC(usart0_rx_status, USART0_RX_BUFFER_SIZE)};
 #endif
 
 #ifdef USART1_ENABLE
-volatile usart_meta_t usart1 = {.usart = &USART1, .pmuxr = &PORTMUX.USARTROUTEA};
+static volatile char usart1_rx_buffer[USART1_RX_BUFFER_SIZE];
+static volatile uint8_t usart1_rx_status[USART_RX_STATUS_SIZE(USART1_RX_BUFFER_SIZE)];
+static volatile char usart1_tx_buffer[USART1_TX_BUFFER_SIZE];
+volatile usart_meta_t usart1 = {.usart = &USART1, .pmuxr = &PORTMUX.USARTROUTEA,
+                                 .rb_rx = RBUFFER_STATIC(usart1_rx_buffer, USART1_RX_BUFFER_SIZE),
+                                 .rb_tx = RBUFFER_STATIC(usart1_tx_buffer, USART1_TX_BUFFER_SIZE),
+                                 .rx_status = RX_STATUS_STATIC(usart1_rx_status, USART1_RX_BUFFER_SIZE)};
 #endif
 
 #ifdef USART2_ENABLE
-volatile usart_meta_t usart2 = {.usart = &USART2, .pmuxr = &PORTMUX.USARTROUTEA};
+static volatile char usart2_rx_buffer[USART2_RX_BUFFER_SIZE];
+static volatile uint8_t usart2_rx_status[USART_RX_STATUS_SIZE(USART2_RX_BUFFER_SIZE)];
+static volatile char usart2_tx_buffer[USART2_TX_BUFFER_SIZE];
+volatile usart_meta_t usart2 = {.usart = &USART2, .pmuxr = &PORTMUX.USARTROUTEA,
+                                 .rb_rx = RBUFFER_STATIC(usart2_rx_buffer, USART2_RX_BUFFER_SIZE),
+                                 .rb_tx = RBUFFER_STATIC(usart2_tx_buffer, USART2_TX_BUFFER_SIZE),
+                                 .rx_status = RX_STATUS_STATIC(usart2_rx_status, USART2_RX_BUFFER_SIZE)};
 #endif
 
 #ifdef USART3_ENABLE
-volatile usart_meta_t usart3 = {.usart = &USART3, .pmuxr = &PORTMUX.USARTROUTEA};
+static volatile char usart3_rx_buffer[USART3_RX_BUFFER_SIZE];
+static volatile uint8_t usart3_rx_status[USART_RX_STATUS_SIZE(USART3_RX_BUFFER_SIZE)];
+static volatile char usart3_tx_buffer[USART3_TX_BUFFER_SIZE];
+volatile usart_meta_t usart3 = {.usart = &USART3, .pmuxr = &PORTMUX.USARTROUTEA,
+                                 .rb_rx = RBUFFER_STATIC(usart3_rx_buffer, USART3_RX_BUFFER_SIZE),
+                                 .rb_tx = RBUFFER_STATIC(usart3_tx_buffer, USART3_TX_BUFFER_SIZE),
+                                 .rx_status = RX_STATUS_STATIC(usart3_rx_status, USART3_RX_BUFFER_SIZE)};
 #endif
 
 #ifdef USART4_ENABLE
-volatile usart_meta_t usart4 = {.usart = &USART4, .pmuxr = &PORTMUX.USARTROUTEB};
+static volatile char usart4_rx_buffer[USART4_RX_BUFFER_SIZE];
+static volatile uint8_t usart4_rx_status[USART_RX_STATUS_SIZE(USART4_RX_BUFFER_SIZE)];
+static volatile char usart4_tx_buffer[USART4_TX_BUFFER_SIZE];
+volatile usart_meta_t usart4 = {.usart = &USART4, .pmuxr = &PORTMUX.USARTROUTEB,
+                                 .rb_rx = RBUFFER_STATIC(usart4_rx_buffer, USART4_RX_BUFFER_SIZE),
+                                 .rb_tx = RBUFFER_STATIC(usart4_tx_buffer, USART4_TX_BUFFER_SIZE),
+                                 .rx_status = RX_STATUS_STATIC(usart4_rx_status, USART4_RX_BUFFER_SIZE)};
 #endif
 
 #ifdef USART5_ENABLE
-volatile usart_meta_t usart5 = {.usart = &USART5, .pmuxr = &PORTMUX.USARTROUTEB};
+static volatile char usart5_rx_buffer[USART5_RX_BUFFER_SIZE];
+static volatile uint8_t usart5_rx_status[USART_RX_STATUS_SIZE(USART5_RX_BUFFER_SIZE)];
+static volatile char usart5_tx_buffer[USART5_TX_BUFFER_SIZE];
+volatile usart_meta_t usart5 = {.usart = &USART5, .pmuxr = &PORTMUX.USARTROUTEB,
+                                 .rb_rx = RBUFFER_STATIC(usart5_rx_buffer, USART5_RX_BUFFER_SIZE),
+                                 .rb_tx = RBUFFER_STATIC(usart5_tx_buffer, USART5_TX_BUFFER_SIZE),
+                                 .rx_status = RX_STATUS_STATIC(usart5_rx_status, USART5_RX_BUFFER_SIZE)};
 #endif
 
 #ifdef USART6_ENABLE
-volatile usart_meta_t usart6 = {.usart = &USART6, .pmuxr = &PORTMUX.USARTROUTEB};
+static volatile char usart6_rx_buffer[USART6_RX_BUFFER_SIZE];
+static volatile uint8_t usart6_rx_status[USART_RX_STATUS_SIZE(USART6_RX_BUFFER_SIZE)];
+static volatile char usart6_tx_buffer[USART6_TX_BUFFER_SIZE];
+volatile usart_meta_t usart6 = {.usart = &USART6, .pmuxr = &PORTMUX.USARTROUTEB,
+                                 .rb_rx = RBUFFER_STATIC(usart6_rx_buffer, USART6_RX_BUFFER_SIZE),
+                                 .rb_tx = RBUFFER_STATIC(usart6_tx_buffer, USART6_TX_BUFFER_SIZE),
+                                 .rx_status = RX_STATUS_STATIC(usart6_rx_status, USART6_RX_BUFFER_SIZE)};
 #endif
 
 #ifdef USART7_ENABLE
-volatile usart_meta_t usart7 = {.usart = &USART7, .pmuxr = &PORTMUX.USARTROUTEB};
+static volatile char usart7_rx_buffer[USART7_RX_BUFFER_SIZE];
+static volatile uint8_t usart7_rx_status[USART_RX_STATUS_SIZE(USART7_RX_BUFFER_SIZE)];
+static volatile char usart7_tx_buffer[USART7_TX_BUFFER_SIZE];
+volatile usart_meta_t usart7 = {.usart = &USART7, .pmuxr = &PORTMUX.USARTROUTEB,
+                                 .rb_rx = RBUFFER_STATIC(usart7_rx_buffer, USART7_RX_BUFFER_SIZE),
+                                 .rb_tx = RBUFFER_STATIC(usart7_tx_buffer, USART7_TX_BUFFER_SIZE),
+                                 .rx_status = RX_STATUS_STATIC(usart7_rx_status, USART7_RX_BUFFER_SIZE)};
+#endif
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// ALL ENABLED UNITS
+static volatile usart_meta_t* const usart_all[] = {
+#ifdef USART0_ENABLE
+    &usart0,
+#endif
+#ifdef USART1_ENABLE
+    &usart1,
+#endif
+#ifdef USART2_ENABLE
+    &usart2,
+#endif
+#ifdef USART3_ENABLE
+    &usart3,
+#endif
+#ifdef USART4_ENABLE
+    &usart4,
+#endif
+#ifdef USART5_ENABLE
+    &usart5,
+#endif
+#ifdef USART6_ENABLE
+    &usart6,
+#endif
+#ifdef USART7_ENABLE
+    &usart7,
+#endif
+};
+#define USART_ALL_COUNT (sizeof(usart_all) / sizeof(usart_all[0]))
+
+static inline bool usart_is_open(volatile usart_meta_t* meta) {
+    return (meta->usart->CTRLB & (USART_RXEN_bm | USART_TXEN_bm));
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// RX STATUS FUNCTIONS (one nibble per rb_rx slot, written by the Rx ISR only)
+static inline void rx_status_put(volatile usart_meta_t* meta, rbuffer_index_t index, uint8_t nibble) {
+    index &= meta->rb_rx.mask;
+    volatile uint8_t* p = meta->rx_status + (index >> 1);
+    if (index & 1) {
+        *p = (*p & 0x0F) | (nibble << 4);
+    }
+    else {
+        *p = (*p & 0xF0) | nibble;
+    }
+}
+
+static inline uint16_t rx_status_get(volatile usart_meta_t* meta, rbuffer_index_t index) {
+    index &= meta->rb_rx.mask;
+    uint8_t nibble = meta->rx_status[index >> 1];
+    if (index & 1) {
+        nibble >>= 4;
+    }
+    return USART_RX_STATUS_UNPACK(nibble & 0x0F);
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// TRUE WHEN THE USART ISRs CAN NOT RUN: GLOBAL INTERRUPTS OFF, OR CALLED FROM AN ISR.
+// AVRxt cores keep SREG.I set in an ISR and block other interrupts with CPUINT.STATUS
+static inline bool usart_irq_blocked(void) {
+    return (!(SREG & CPU_I_bm) || (CPUINT.STATUS & (CPUINT_LVL0EX_bm | CPUINT_LVL1EX_bm)));
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+#if defined(USART_RTSCTS) || defined(USART_AUTOBAUD)
+// PINnCTRL of the lowest PIN in 'pin_bm', NULL if none
+static register8_t* usart_pinctrl(PORT_t* port, uint8_t pin_bm) {
+    if (!pin_bm) {
+        return NULL;
+    }
+    register8_t* pinctrl = &port->PIN0CTRL;
+    for (; !(pin_bm & 0x01); pin_bm >>= 1) {
+        pinctrl++;
+    }
+    return pinctrl;
+}
+#endif
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// IDLE SLEEP WAIT (never when usart_irq_blocked()); 'cond' is tested with interrupts off
+// and sei() delays them until after sleep_cpu(), so no wakeup is lost in between
+#define USART_SLEEP_WHILE(cond) do {                                \
+        uint8_t smode = SLPCTRL.CTRLA;                              \
+        cli();                                                      \
+        SLPCTRL.CTRLA = SLPCTRL_SMODE_IDLE_gc | SLPCTRL_SEN_bm;     \
+        while (cond) {                                              \
+            sei();                                                  \
+            sleep_cpu();                                            \
+            cli();                                                  \
+        }                                                           \
+        SLPCTRL.CTRLA = smode;                                      \
+        sei();                                                      \
+    } while (0)
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// FLOW CONTROL FUNCTIONS (RTS, CTS active low)
+#ifdef USART_RTSCTS
+static inline bool usart_cts_paused(volatile usart_meta_t* meta) {
+    return (meta->fc_port && (meta->fc_port->IN & meta->cts_pin));
+}
 #endif
 
+// Read path: resume the sender once rb_rx has drained below the low watermark
+static inline void usart_rx_released(volatile usart_meta_t* meta) {
+#ifdef USART_RTSCTS
+    if (meta->fc_port) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (rbuffer_count(&meta->rb_rx) <= meta->rx_low) {
+                meta->fc_port->OUTCLR = meta->rts_pin;  // Assert RTS
+            }
+        }
+    }
+#endif
+#ifdef USART_XONXOFF
+    if (meta->rx_stopped) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (rbuffer_count(&meta->rb_rx) <= meta->rx_low) {
+                meta->rx_stopped = 0;
+                meta->x_pending = USART_XON;            // Sent ahead of queued data
+                meta->usart->CTRLA |= USART_DREIE_bm;
+            }
+        }
+    }
+#endif
+}
+
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 // USART FUNCTIONS
 void usart_set(volatile usart_meta_t* meta, PORT_t*  port, uint8_t route_gc, uint8_t tx_pin, uint8_t rx_pin) {
@@ -99,21 +242,215 @@ void usart_set(volatile usart_meta_t* meta, PORT_t*  port, uint8_t route_gc, uin
     meta->route = route_gc;
     meta->tx_pin = tx_pin;
     meta->rx_pin = rx_pin;
+    meta->format = USART_CHSIZE_8BIT_gc;                    // 8N1 unless usart_set_format()
+}
+
+// Bind caller storage to a closed USART; sizes MUST be powers of 2 up to RBUFFER_SIZE_MAX
+// (see RBUFFER_INDEX16) and rx_status MUST hold USART_RX_STATUS_SIZE(rx_size) bytes for
+// the per-byte Rx status. Returns false, binding nothing, for NULL storage or invalid size
+bool usart_set_buffer(volatile usart_meta_t* meta, char* rx_buffer, uint16_t rx_size, uint8_t* rx_status, char* tx_buffer, uint16_t tx_size) {
+    if (!rx_buffer || !rx_status || !tx_buffer || !rbuffer_size_ok(rx_size) || !rbuffer_size_ok(tx_size)) {
+        return false;
+    }
+    meta->rb_rx.buffer = rx_buffer;
+    meta->rb_rx.mask = rx_size - 1;
+    meta->rx_status = rx_status;
+    meta->rb_tx.buffer = tx_buffer;
+    meta->rb_tx.mask = tx_size - 1;
+    return true;
 }
 
-void usart_init(volatile usart_meta_t* meta, uint16_t baud_rate) {
+// Select what the Rx ISR does when rb_rx is full; USART_RX_DROP_NEWEST is the default
+void usart_set_rx_policy(volatile usart_meta_t* meta, uint8_t policy) {
+    meta->rx_policy = policy;
+}
+
+#ifdef USART_RTSCTS
+// RTS output, CTS input on any PORT; the PORTn_PORT_vect ISR MUST call usart_cts_isr().
+// cts_pin 0 for RTS only (Tx never paused)
+void usart_set_rtscts(volatile usart_meta_t* meta, PORT_t* port, uint8_t rts_pin, uint8_t cts_pin) {
+    meta->fc_port = port;
+    meta->rts_pin = rts_pin;
+    meta->cts_pin = cts_pin;
+}
+#endif
+
+#ifdef USART_XONXOFF
+void usart_set_xonxoff(volatile usart_meta_t* meta, bool enable) {
+    meta->xonxoff = enable;
+}
+#endif
+
+// USART_RXMODE_NORMAL_gc (default) or USART_RXMODE_CLK2X_gc; see USART_RXMODE()
+void usart_set_rxmode(volatile usart_meta_t* meta, uint8_t rxmode_gc) {
+    meta->rxmode = rxmode_gc;
+}
+
+// Asynchronous frame format; USART_PMODE_x_gc | USART_SBMODE_x_gc | USART_CHSIZE_x_gc.
+// Returns false, keeping the format, for a 9-bit (or reserved) character size: Rx and Tx
+// only carry 8 data bits
+bool usart_set_format(volatile usart_meta_t* meta, uint8_t format) {
+    if ((format & USART_CHSIZE_gm) > USART_CHSIZE_8BIT_gc) {
+        return false;
+    }
+    meta->format = format & ~USART_CMODE_gm;
+    return true;
+}
+
+// CTRLC for the frame format; 9-bit multiprocessor mode overrides the character size
+static inline uint8_t usart_ctrlc(volatile usart_meta_t* meta) {
+    uint8_t ctrlc = meta->format;
+#ifdef USART_MPCM
+    if (meta->mpcm) {
+        ctrlc = (ctrlc & ~USART_CHSIZE_gm) | USART_CHSIZE_9BITH_gc;
+    }
+#endif
+    return ctrlc;
+}
+
+// USART_OSC_CAL_3V or _5V makes usart_init() correct 'baud_rate' for this device's oscillator.
+// Ignored on parts without OSC20M error bytes in SIGROW (AVR Dx/Ex)
+void usart_set_osc_cal(volatile usart_meta_t* meta, uint8_t osc_cal) {
+    meta->osc_cal = osc_cal;
+}
+
+#ifdef SIGROW_OSC20ERR3V
+// Factory error of the OSC16/OSC20 oscillator (FREQSEL fuse) in 1/1024; BAUD scales with it
+static uint16_t usart_osc_cal_baud(uint8_t osc_cal, uint16_t baud_rate) {
+    int8_t err;
+    if ((CLKCTRL.MCLKCTRLA & CLKCTRL_CLKSEL_gm) != CLKCTRL_CLKSEL_OSC20M_gc) {
+        return baud_rate;                                   // External clock or OSCULP32K
+    }
+    if ((FUSE.OSCCFG & FUSE_FREQSEL_gm) == FREQSEL_16MHZ_gc) {
+        err = (osc_cal == USART_OSC_CAL_3V) ? SIGROW.OSC16ERR3V : SIGROW.OSC16ERR5V;
+    }
+    else {
+        err = (osc_cal == USART_OSC_CAL_3V) ? SIGROW.OSC20ERR3V : SIGROW.OSC20ERR5V;
+    }
+    uint32_t baud = ((uint32_t)baud_rate * (uint16_t)(1024 + err) + 512) / 1024;
+    return (baud > 0xFFFF) ? 0xFFFF : baud;
+}
+#endif
+
+// RS485 mode USART_RS485_EXT_gc drives XDIR (a PIN of the USART PORT) during Tx,
+// USART_RS485_INT_gc only enables the Tx driver during Tx; USART_RS485_OFF_gc to disable
+void usart_set_rs485(volatile usart_meta_t* meta, uint8_t rs485_gc, uint8_t xdir_pin) {
+    meta->rs485 = rs485_gc;
+    meta->xdir_pin = xdir_pin;
+}
+
+// Called from the TXC ISR when the last queued byte has left the shift register
+void usart_set_tx_done(volatile usart_meta_t* meta, void (*tx_done)(volatile usart_meta_t* meta)) {
+    meta->tx_done = tx_done;
+}
+
+#ifdef USART_MPCM
+// 9-bit multiprocessor mode; USART_MPCM_SLAVE only receives data after its own (or the
+// USART_MPCM_BROADCAST) address frame, USART_MPCM_MASTER sends address frames
+void usart_set_mpcm(volatile usart_meta_t* meta, uint8_t mode, uint8_t address) {
+    meta->mpcm = mode;
+    meta->mpcm_address = address;
+}
+#endif
+
+// Returns false, leaving the unit disabled, if no ringbuffer storage is bound (size 0)
+bool usart_init(volatile usart_meta_t* meta, uint16_t baud_rate) {
+    if (!meta->rb_rx.buffer || !meta->rx_status || !meta->rb_tx.buffer) {
+        return false;
+    }
     rbuffer_init(&meta->rb_rx);                             // Init Rx buffer
     rbuffer_init(&meta->rb_tx);                             // Init Tx buffer
+    meta->usart_error = 0;
+    meta->rx_dropped = 0;
     *meta->pmuxr |= meta->route;                            // Set Rx, Tx PIN route
     meta->port->DIR &= ~meta->rx_pin;                       // Rx PIN input
     meta->port->DIR |= meta->tx_pin;                        // Tx PIN output
+#if defined(USART_RTSCTS) || defined(USART_XONXOFF)
+    meta->rx_high = meta->rb_rx.mask - (meta->rb_rx.mask >> 2);
+    meta->rx_low = (meta->rb_rx.mask >> 2);
+#endif
+#ifdef USART_XONXOFF
+    meta->tx_paused = 0;
+    meta->rx_stopped = 0;
+    meta->x_pending = 0;
+#endif
+#ifdef USART_RTSCTS
+    if (meta->fc_port) {
+        register8_t* pinctrl = usart_pinctrl(meta->fc_port, meta->cts_pin);
+        meta->fc_port->OUTCLR = meta->rts_pin;              // Assert RTS, ready to receive
+        meta->fc_port->DIRSET = meta->rts_pin;              // RTS PIN output
+        if (pinctrl) {                                      // No CTS pin: RTS only
+            meta->fc_port->DIRCLR = meta->cts_pin;          // CTS PIN input
+            *pinctrl = (*pinctrl & ~PORT_ISC_gm) | PORT_ISC_BOTHEDGES_gc;
+        }
+    }
+#endif
+    meta->tx_busy = 0;
+    meta->closing = 0;
+    meta->port->DIR |= meta->xdir_pin;                      // XDIR PIN output (if any)
+    meta->usart->CTRLA = (meta->usart->CTRLA & ~USART_RS485_gm) | meta->rs485;
+#ifdef SIGROW_OSC20ERR3V
+    if (meta->osc_cal != USART_OSC_CAL_OFF) {
+        baud_rate = usart_osc_cal_baud(meta->osc_cal, baud_rate);
+    }
+#endif
     meta->usart->BAUD = baud_rate;                          // Set BAUD rate
+    meta->usart->CTRLB = (meta->usart->CTRLB & ~USART_RXMODE_gm) | meta->rxmode;
+    meta->usart->CTRLC = usart_ctrlc(meta);                 // Frame format
+#ifdef USART_MPCM
+    if (meta->mpcm == USART_MPCM_SLAVE) {
+        meta->usart->CTRLB |= USART_MPCM_bm;                // Ignore data until addressed
+    }
+#endif
     meta->usart->CTRLB |= (USART_RXEN_bm | USART_TXEN_bm);  // Enable Rx, Tx units
     meta->usart->CTRLA |= USART_RXCIE_bm;                   // Enable Rx interrupt 
+    return true;
+}
+
+// Every byte written to TXDATAL clears TXCIF first, so TXC marks the end of the last one
+static inline void usart_tx_put(volatile usart_meta_t* meta, char c) {
+    USART_t* const usart = meta->usart;
+    usart->STATUS = USART_TXCIF_bm;
+#ifdef USART_MPCM
+    if (meta->mpcm) {
+        usart->TXDATAH = 0;                                 // 9th bit 0: data frame
+    }
+#endif
+    usart->TXDATAL = c;
+    meta->tx_busy = 1;
+}
+
+// With global interrupts off (in an ISR, before sei() or after cli()) the DRE ISR can
+// never drain the Tx ringbuffer; empty it by polling DREIF, oldest byte first
+static void usart_tx_flush_polled(volatile usart_meta_t* meta) {
+#ifdef USART_XONXOFF
+    if (meta->x_pending) {
+        while (!(meta->usart->STATUS & USART_DREIF_bm));
+        usart_tx_put(meta, meta->x_pending);
+        meta->x_pending = 0;
+    }
+#endif
+    while (!rbuffer_empty(&meta->rb_tx)) {
+        while (!(meta->usart->STATUS & USART_DREIF_bm));
+#ifdef USART_RTSCTS
+        while (usart_cts_paused(meta));
+#endif
+        usart_tx_put(meta, rbuffer_remove(&meta->rb_tx));
+    }
 }
 
 void usart_send_char(volatile usart_meta_t* meta, char c) {
-    while(rbuffer_full(&meta->rb_tx));
+    if (usart_irq_blocked()) {                              // Polled Tx; keeps ringbuffer order
+        usart_tx_flush_polled(meta);
+        while (!(meta->usart->STATUS & USART_DREIF_bm));
+#ifdef USART_RTSCTS
+        while (usart_cts_paused(meta));
+#endif
+        usart_tx_put(meta, c);
+        meta->usart->CTRLA |= USART_TXCIE_bm;               // TXC ends tx_busy once enabled
+        return;
+    }
+    USART_SLEEP_WHILE(rbuffer_full(&meta->rb_tx));          // DRE ISR frees a slot
     rbuffer_insert(c, &meta->rb_tx);
     meta->usart->CTRLA |= USART_DREIE_bm;                   // Enable Tx interrupt 
 }
@@ -131,29 +468,461 @@ void usart_send_string_P(volatile usart_meta_t* meta, const char* chr) {
     }
 }
 
-uint8_t usart_rx_count(volatile usart_meta_t* meta) {
+rbuffer_index_t usart_tx_reserve(volatile usart_meta_t* meta, char** data) {
+    return rbuffer_reserve(&meta->rb_tx, data);
+}
+
+void usart_tx_commit(volatile usart_meta_t* meta, rbuffer_index_t n) {
+    if (n) {
+        rbuffer_commit(&meta->rb_tx, n);
+        meta->usart->CTRLA |= USART_DREIE_bm;               // Enable Tx interrupt 
+    }
+}
+
+// Queues as much of 'len' as fits right now (at most two copies around the wrap)
+static size_t usart_write_some(volatile usart_meta_t* meta, const char* src, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        char* dst;
+        rbuffer_index_t n = rbuffer_reserve(&meta->rb_tx, &dst);
+        if (n == 0) {
+            break;
+        }
+        if (n > len - done) {
+            n = len - done;
+        }
+        memcpy(dst, src + done, n);
+        usart_tx_commit(meta, n);
+        done += n;
+    }
+    return done;
+}
+
+// Blocks until all of 'len' is queued
+size_t usart_write(volatile usart_meta_t* meta, const void* data, size_t len) {
+    const char* src = data;
+    size_t done = 0;
+    if (usart_irq_blocked()) {
+        while (done < len) {
+            usart_send_char(meta, src[done++]);
+        }
+        return len;
+    }
+    while (done < len) {
+        done += usart_write_some(meta, src + done, len - done);
+        if (done < len) {
+            USART_SLEEP_WHILE(rbuffer_full(&meta->rb_tx));
+        }
+    }
+    return len;
+}
+
+// Non-blocking variants; return the number of bytes accepted into the Tx ringbuffer
+uint8_t usart_try_send_char(volatile usart_meta_t* meta, char c) {
+    if (rbuffer_full(&meta->rb_tx)) {
+        return 0;
+    }
+    rbuffer_insert(c, &meta->rb_tx);
+    meta->usart->CTRLA |= USART_DREIE_bm;                   // Enable Tx interrupt 
+    return 1;
+}
+
+size_t usart_try_send_string(volatile usart_meta_t* meta, const char* str) {
+    return usart_write_some(meta, str, strlen(str));
+}
+
+size_t usart_try_write(volatile usart_meta_t* meta, const void* data, size_t len) {
+    return usart_write_some(meta, data, len);
+}
+
+rbuffer_index_t usart_tx_free(volatile usart_meta_t* meta) {
+    return meta->rb_tx.mask - rbuffer_count(&meta->rb_tx) + 1;
+}
+
+rbuffer_index_t usart_rx_count(volatile usart_meta_t* meta) {
     return rbuffer_count(&meta->rb_rx);
 }
 
+// With USART_RX_OVERWRITE_OLDEST the ISR moves 'out' too and may overwrite a held
+// region, so zero-copy reading is not available; use usart_read()/usart_read_char()
+rbuffer_index_t usart_rx_peek(volatile usart_meta_t* meta, const char** data) {
+    if (meta->rx_policy == USART_RX_OVERWRITE_OLDEST) {
+        *data = NULL;
+        return 0;
+    }
+    return rbuffer_peek(&meta->rb_rx, data);
+}
+
+void usart_rx_consume(volatile usart_meta_t* meta, rbuffer_index_t n) {
+    if (meta->rx_policy == USART_RX_OVERWRITE_OLDEST) {    // Skip bytes; ISR may move 'out' as well
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            rbuffer_index_t count = rbuffer_count(&meta->rb_rx);
+            rbuffer_consume(&meta->rb_rx, (n < count) ? n : count);
+        }
+    }
+    else {
+        rbuffer_consume(&meta->rb_rx, n);
+    }
+    usart_rx_released(meta);
+}
+
+// Non-blocking; copies up to 'len' received bytes and returns the number copied
+size_t usart_read(volatile usart_meta_t* meta, void* data, size_t len) {
+    char* dst = data;
+    size_t done = 0;
+    if (meta->rx_policy == USART_RX_OVERWRITE_OLDEST) {    // ISR may move 'out'; go byte by byte
+        while ((done < len) && !rbuffer_empty(&meta->rb_rx)) {
+            dst[done++] = (char)usart_read_char(meta);
+        }
+        return done;
+    }
+    while (done < len) {
+        const char* src;
+        rbuffer_index_t n = rbuffer_peek(&meta->rb_rx, &src);
+        if (n == 0) {
+            break;
+        }
+        if (n > len - done) {
+            n = len - done;
+        }
+        memcpy(dst + done, src, n);
+        rbuffer_consume(&meta->rb_rx, n);
+        done += n;
+    }
+    usart_rx_released(meta);
+    return done;
+}
+
+// Error bits in the high byte belong to this very character
 uint16_t usart_read_char(volatile usart_meta_t* meta) {
-    if (!rbuffer_empty(&meta->rb_rx)) {
-        return (((meta->usart_error & USART_RX_ERROR_MASK) << 8) | (uint16_t)rbuffer_remove(&meta->rb_rx));
+    uint16_t c = USART_NO_DATA;                                 // Empty ringbuffer
+    if (meta->rx_policy == USART_RX_OVERWRITE_OLDEST) {         // ISR may move 'out' as well
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (!rbuffer_empty(&meta->rb_rx)) {
+                c = rx_status_get(meta, meta->rb_rx.out);
+                c |= (uint8_t)rbuffer_remove(&meta->rb_rx);
+            }
+        }
+    }
+    else if (!rbuffer_empty(&meta->rb_rx)) {
+        c = rx_status_get(meta, meta->rb_rx.out);
+        c |= (uint8_t)rbuffer_remove(&meta->rb_rx);
+    }
+    usart_rx_released(meta);
+    return c;
+}
+
+#ifdef USART_MPCM
+// Queued data is sent first; the address frame then precedes any data sent after it
+void usart_send_address(volatile usart_meta_t* meta, uint8_t address) {
+    if (usart_irq_blocked()) {
+        usart_tx_flush_polled(meta);
     }
     else {
-        return (((meta->usart_error & USART_RX_ERROR_MASK) << 8) | USART_NO_DATA);     // Empty ringbuffer
+        USART_SLEEP_WHILE(!rbuffer_empty(&meta->rb_tx));
+    }
+    while (!(meta->usart->STATUS & USART_DREIF_bm));        // At most one character time
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        meta->usart->STATUS = USART_TXCIF_bm;
+        meta->usart->TXDATAH = USART_DATA8_bm;              // 9th bit 1: address frame
+        meta->usart->TXDATAL = address;
+        meta->tx_busy = 1;
+        meta->usart->CTRLA |= USART_TXCIE_bm;
     }
 }
+#endif
 
-void usart_close(volatile usart_meta_t* meta) {
-    while(!rbuffer_empty(&meta->rb_tx));                        // Wait for Tx to transmit ALL characters in ringbuffer
-    while(!(meta->usart->STATUS & USART_DREIF_bm));             // Wait for Tx unit to transmit the LAST character of ringbuffer
+#ifdef USART_AUTOBAUD
+// GENAUTO or LINAUTO; NORMAL and CLK2X are not auto-baud modes
+static inline bool usart_autobaud_armed(USART_t* const usart) {
+    uint8_t mode = usart->CTRLB & USART_RXMODE_gm;
+    return ((mode == USART_RXMODE_GENAUTO_gc) || (mode == USART_RXMODE_LINAUTO_gc));
+}
 
-    _delay_ms(200);                                             // Extra safety for Tx to finish!
+// BDF has no interrupt of its own and clears when the next byte has been received, so it
+// is sampled at each start bit by usart_rxd_isr(), where it is still set if the sync field
+// just ended. A BAUD differing from the last known value also counts.
+// Interrupts off. Returns true for a new measurement
+static bool usart_autobaud_poll(volatile usart_meta_t* meta, USART_t* const usart, uint8_t flags) {
+    uint16_t baud = usart->BAUD;
+    if (!(flags & USART_BDF_bm) && (baud == meta->baud_armed)) {
+        return false;
+    }
+    usart->STATUS = USART_BDF_bm;
+    meta->baud_measured = baud;
+    meta->baud_armed = baud;                                // Next change is relative to this
+    if ((usart->CTRLB & USART_RXMODE_gm) == USART_RXMODE_GENAUTO_gc) {
+        usart->CTRLB &= ~USART_RXMODE_gm;                   // Latch it
+        usart->CTRLA &= ~USART_ABEIE_bm;
+        register8_t* pinctrl = usart_pinctrl(meta->port, meta->rx_pin);
+        *pinctrl = (*pinctrl & ~PORT_ISC_gm) | PORT_ISC_INTDISABLE_gc;
+    }
+    return true;
+}
 
+// Call from the PORTn_PORT_vect ISR of the Rx pin; samples BDF at every falling edge, i.e.
+// at the start bit following the sync field. The next received byte reports the break
+void usart_rxd_isr(volatile usart_meta_t* meta) {
+    meta->port->INTFLAGS = meta->rx_pin;
+    if (usart_autobaud_armed(meta->usart) && usart_autobaud_poll(meta, meta->usart, meta->usart->STATUS)) {
+        meta->brk_seen = 1;
+    }
+}
+
+// Call after usart_init(); USART_RXMODE_GENAUTO_gc latches the first measured BAUD,
+// USART_RXMODE_LINAUTO_gc keeps re-measuring on every LIN break + sync field
+void usart_autobaud(volatile usart_meta_t* meta, uint8_t rxmode_gc) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        meta->baud_measured = 0;
+        meta->baud_armed = meta->usart->BAUD;
+        meta->brk_seen = 0;
+        register8_t* pinctrl = usart_pinctrl(meta->port, meta->rx_pin);
+        *pinctrl = (*pinctrl & ~PORT_ISC_gm) | PORT_ISC_FALLING_gc;     // usart_rxd_isr()
+        meta->usart->STATUS = (USART_BDF_bm | USART_ISFIF_bm);
+        meta->usart->CTRLB = (meta->usart->CTRLB & ~USART_RXMODE_gm) | rxmode_gc;
+        meta->usart->CTRLA |= USART_ABEIE_bm;               // ISFIF shares the Rx vector
+        if (rxmode_gc == USART_RXMODE_GENAUTO_gc) {
+            meta->usart->STATUS = USART_WFB_bm;             // Next low period is a break
+        }
+    }
+}
+
+// Measured BAUD register value, 0 while still waiting for a valid break + sync field
+uint16_t usart_autobaud_result(volatile usart_meta_t* meta) {
+    uint16_t baud;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (usart_autobaud_armed(meta->usart)) {           // Still armed; poll BDF and BAUD
+            usart_autobaud_poll(meta, meta->usart, meta->usart->STATUS);
+        }
+        baud = meta->baud_measured;
+    }
+    return baud;
+}
+#endif
+
+#ifdef USART_SFD
+// True once no open unit has Tx data queued or in the shifter
+static bool usart_all_tx_done(void) {
+    for (uint8_t i = 0; i < USART_ALL_COUNT; i++) {
+        if (usart_is_open(usart_all[i]) && !usart_tx_done(usart_all[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Standby until a byte is in the Rx ringbuffer; the start bit restarts the peripheral
+// clock so that byte is received intact. Other interrupts wake the CPU but sleep resumes
+void usart_sleep_until_rx(volatile usart_meta_t* meta) {
+    if (usart_irq_blocked()) {
+        return;                                             // Rx ISR could never wake us
+    }
+    USART_SLEEP_WHILE(!usart_all_tx_done());                // Tx of every unit halts in standby
+    uint8_t sreg = SREG;
+    uint8_t smode = SLPCTRL.CTRLA;
+    cli();
+    meta->usart->STATUS = USART_RXSIF_bm;
+    meta->usart->CTRLB |= USART_SFDEN_bm;                   // Start bit wakes the USART
+    meta->usart->CTRLA |= USART_RXSIE_bm;                   // RXSIF shares the Rx vector
+    SLPCTRL.CTRLA = SLPCTRL_SMODE_STDBY_gc | SLPCTRL_SEN_bm;
+    while (rbuffer_empty(&meta->rb_rx)) {
+        sei();                                              // Takes effect after sleep_cpu()
+        sleep_cpu();
+        cli();
+    }
+    SLPCTRL.CTRLA = smode;
+    meta->usart->CTRLA &= ~USART_RXSIE_bm;
+    meta->usart->CTRLB &= ~USART_SFDEN_bm;
+    SREG = sreg;
+}
+#endif
+
+// True once every queued byte has been shifted out on the wire
+bool usart_tx_done(volatile usart_meta_t* meta) {
+    return (rbuffer_empty(&meta->rb_tx) && !meta->tx_busy);
+}
+
+// Running count of Rx bytes lost (full ringbuffer or hardware overrun) since usart_init()
+uint16_t usart_rx_dropped(volatile usart_meta_t* meta) {
+    uint16_t dropped;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        dropped = meta->rx_dropped;
+    }
+    return dropped;
+}
+
+// Error bits of the received byte at 'offset' from the oldest (as from usart_rx_peek())
+uint16_t usart_rx_error(volatile usart_meta_t* meta, rbuffer_index_t offset) {
+    return rx_status_get(meta, meta->rb_rx.out + offset);
+}
+
+// Disables the unit; Tx must already be complete
+static void usart_shutdown(volatile usart_meta_t* meta) {
     meta->usart->CTRLB &= ~(USART_RXEN_bm | USART_TXEN_bm);     // Disable Tx, Rx unit
-    meta->usart->CTRLA &= ~(USART_RXCIE_bm | USART_DREIE_bm);   // Disable Tx, Rx interrupt
+#ifdef USART_MPCM
+    meta->usart->CTRLB &= ~USART_MPCM_bm;
+#endif
+    meta->usart->CTRLA &= ~(USART_RXCIE_bm | USART_DREIE_bm | USART_TXCIE_bm | USART_RS485_gm);   // Disable Tx, Rx interrupt, RS485
+#ifdef USART_SFD
+    meta->usart->CTRLA &= ~USART_RXSIE_bm;
+    meta->usart->CTRLB &= ~USART_SFDEN_bm;
+#endif
+#ifdef USART_AUTOBAUD
+    if (usart_autobaud_armed(meta->usart)) {
+        register8_t* pinctrl = usart_pinctrl(meta->port, meta->rx_pin);
+        *pinctrl = (*pinctrl & ~PORT_ISC_gm) | PORT_ISC_INTDISABLE_gc;
+    }
+    meta->usart->CTRLA &= ~USART_ABEIE_bm;
+    meta->usart->CTRLB &= ~USART_RXMODE_gm;
+#endif
+    meta->tx_busy = 0;
+    meta->closing = 0;
+
+#ifdef USART_RTSCTS
+    if (meta->fc_port) {
+        meta->fc_port->OUTSET = meta->rts_pin;                  // Deassert RTS
+    }
+#endif
+}
+
+// Returns one character time after the last queued byte, when TXCIF marks it sent
+static void usart_tx_drain(volatile usart_meta_t* meta) {
+    if (usart_irq_blocked()) {
+        usart_tx_flush_polled(meta);
+        if (meta->tx_busy) {
+            while(!(meta->usart->STATUS & USART_TXCIF_bm));     // Wait for Tx unit to shift out the LAST character
+        }
+    }
+    else {
+        USART_SLEEP_WHILE(!usart_tx_done(meta));                // DRE drains the ringbuffer, TXC ends the LAST character
+    }
+}
+
+void usart_close(volatile usart_meta_t* meta) {
+    usart_tx_drain(meta);
+    usart_shutdown(meta);
+}
+
+// Changes the frame format of an open unit once queued Tx data is sent; bytes in the
+// Rx ringbuffer are kept, a byte being received may be lost. False as usart_set_format()
+bool usart_change_format(volatile usart_meta_t* meta, uint8_t format) {
+    if (!usart_set_format(meta, format)) {
+        return false;
+    }
+    usart_tx_drain(meta);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        meta->usart->CTRLB &= ~USART_RXEN_bm;                   // Restart Rx in the new format
+        meta->usart->CTRLC = usart_ctrlc(meta);
+        meta->usart->CTRLB |= USART_RXEN_bm;
+    }
+    return true;
+}
+
+// Returns at once; the unit is disabled from the TXC ISR (or here if Tx is idle) and
+// 'closed' (may be NULL) called. Queue nothing more after this call
+void usart_close_async(volatile usart_meta_t* meta, void (*closed)(volatile usart_meta_t* meta)) {
+    bool idle;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        meta->closed = closed;
+        idle = usart_tx_done(meta);
+        if (idle) {
+            usart_shutdown(meta);
+        }
+        else {
+            meta->closing = 1;
+        }
+    }
+    if (idle && closed) {
+        closed(meta);
+    }
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// RUNTIME CLOCK CHANGE
+static uint32_t usart_f_clk = F_CPU;                            // Clock the open units' BAUD values are for
+
+// baud * f_new / f_old rounded, in 32 bits: the whole ratio first, then the remainder
+// by long division over the nibbles of baud. f_old must be below 2^27 (134 MHz)
+static uint32_t usart_rescale(uint16_t baud, uint32_t f_new, uint32_t f_old) {
+    uint32_t q = f_new / f_old;
+    uint32_t r = f_new % f_old;
+    if (q > 0xFFFF) {
+        return UINT32_MAX;
+    }
+    uint32_t frac = 0;
+    uint32_t rem = 0;
+    for (int8_t shift = 12; shift >= 0; shift -= 4) {
+        rem = (rem << 4) + ((baud >> shift) & 0x0F) * r;    // Below 31 * f_old
+        frac = (frac << 4) + rem / f_old;
+        rem %= f_old;
+    }
+    return (uint32_t)baud * q + frac + (rem >= f_old - rem);
 }
 
+// Writes CLKCTRL.MCLKCTRLB (main clock prescaler) once Tx of every open unit has drained
+// and rescales their BAUD for the new peripheral clock 'f_clk' (Hz). Returns false, and
+// changes nothing, if an open unit's rate can not be reached at 'f_clk' or a LIN frame is
+// in progress (its break BAUD would be taken as the nominal one). A byte being received
+// during the switch may be garbled
+bool usart_set_clock(uint8_t mclkctrlb, uint32_t f_clk) {
+    uint16_t baud[USART_ALL_COUNT] = {0};
+    for (uint8_t i = 0; i < USART_ALL_COUNT; i++) {
+        if (!usart_is_open(usart_all[i])) {
+            continue;
+        }
+        uint32_t b = usart_rescale(usart_all[i]->usart->BAUD, f_clk, usart_f_clk);
+        if ((b < 64) || (b > 0xFFFF)) {
+            return false;
+        }
+        baud[i] = b;
+    }
+    for (uint8_t i = 0; i < USART_ALL_COUNT; i++) {
+        if (usart_is_open(usart_all[i])) {
+            usart_tx_drain(usart_all[i]);
+        }
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#ifdef USART_LIN
+        for (uint8_t i = 0; i < USART_ALL_COUNT; i++) {
+            if (usart_is_open(usart_all[i]) && usart_all[i]->lin && lin_busy(usart_all[i]->lin)) {
+                return false;
+            }
+        }
+#endif
+        _PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, mclkctrlb);
+        for (uint8_t i = 0; i < USART_ALL_COUNT; i++) {
+            if (!usart_is_open(usart_all[i])) {
+                continue;
+            }
+            usart_all[i]->usart->BAUD = baud[i];
+#ifdef USART_AUTOBAUD
+            usart_all[i]->baud_armed = baud[i];              // Not a measurement
+#endif
+#ifdef USART_LIN
+            if (usart_all[i]->lin) {
+                usart_all[i]->lin->baud = baud[i];
+            }
+#endif
+        }
+        usart_f_clk = f_clk;
+    }
+    return true;
+}
+
+#ifdef USART_RTSCTS
+// Call from the PORTn_PORT_vect ISR of the CTS pin; resumes Tx once CTS is asserted
+void usart_cts_isr(volatile usart_meta_t* meta) {
+    meta->fc_port->INTFLAGS = meta->cts_pin;
+    bool pending = !rbuffer_empty(&meta->rb_tx);
+#ifdef USART_XONXOFF
+    pending |= (meta->x_pending != 0);                          // XON/XOFF held back by CTS
+#endif
+    if (!usart_cts_paused(meta) && pending) {
+        meta->usart->CTRLA |= USART_DREIE_bm;                   // Enable Tx interrupt 
+    }
+}
+#endif
+
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 // STREAM SETUP (OPTIONAL)
 #ifdef USART_STREAM
@@ -226,23 +995,152 @@ void usart_close(volatile usart_meta_t* meta) {
 
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 // ISR HELPER FUNCTIONS
-static inline void isr_usart_rxc_vect(volatile usart_meta_t* meta) {
-    char data = meta->usart->RXDATAL;
-    if(!rbuffer_full(&meta->rb_rx)) {
-        rbuffer_insert(data, &meta->rb_rx);
-        meta->usart_error = meta->usart->RXDATAH;
+// One received byte (or flag-only event); 'usart' is meta->usart, loaded once per ISR
+static inline void isr_usart_rx_byte(volatile usart_meta_t* meta, USART_t* const usart) {
+#ifdef USART_SFD
+    if (usart->STATUS & USART_RXSIF_bm) {                   // Woken by a start bit
+        usart->STATUS = USART_RXSIF_bm;
+        if (!(usart->STATUS & USART_RXCIF_bm)) {
+            return;                                         // Byte still arriving
+        }
     }
-    else {
-        meta->usart_error = (meta->usart->RXDATAH | USART_BUFFER_OVERFLOW>>8);
+#endif
+#ifdef USART_AUTOBAUD
+    uint8_t flags = usart->STATUS;
+    if (flags & USART_ISFIF_bm) {                           // Bad sync field; wait for next break
+        usart->STATUS = USART_ISFIF_bm;
+        if ((usart->CTRLB & USART_RXMODE_gm) == USART_RXMODE_GENAUTO_gc) {
+            usart->STATUS = USART_WFB_bm;
+        }
+        return;
     }
+#ifdef USART_LIN
+    bool measured = meta->brk_seen;                         // Sampled at this byte's start bit
+#endif
+    meta->brk_seen = 0;
+    if (usart_autobaud_armed(usart)) {                     // Break + sync may be done
+#ifdef USART_LIN
+        measured |=
+#endif
+        usart_autobaud_poll(meta, usart, flags);
+    }
+    if (!(flags & USART_RXCIF_bm)) {
+        return;
+    }
+#endif
+    uint8_t status = usart->RXDATAH;                        // MUST be read before RXDATAL
+    char data = usart->RXDATAL;
+#ifdef USART_LIN
+    if (meta->lin) {                                        // LIN engine consumes every byte
+        lin_isr_rxc(meta->lin, status, data, measured);
+        return;
+    }
+#endif
+    if (status & USART_BUFOVF_bm) {
+        meta->rx_dropped++;                                 // Hardware overrun; at least one byte
+    }
+#ifdef USART_MPCM
+    if ((meta->mpcm == USART_MPCM_SLAVE) && (status & USART_DATA8_bm)) {
+        if ((data == meta->mpcm_address) || (data == (char)USART_MPCM_BROADCAST)) {
+            usart->CTRLB &= ~USART_MPCM_bm;                 // Addressed; receive data frames
+        }
+        else {
+            usart->CTRLB |= USART_MPCM_bm;                  // Hardware drops data frames
+        }
+        return;
+    }
+#endif
+#ifdef USART_XONXOFF
+    if (meta->xonxoff && !(status & (USART_FERR_bm | USART_PERR_bm))) {
+        if (data == USART_XOFF) {                           // Peer asks us to pause Tx
+            meta->tx_paused = 1;
+            return;
+        }
+        if (data == USART_XON) {
+            meta->tx_paused = 0;
+            usart->CTRLA |= USART_DREIE_bm;
+            return;
+        }
+    }
+#endif
+    if(rbuffer_full(&meta->rb_rx)) {
+        meta->rx_dropped++;
+        if (meta->rx_policy != USART_RX_OVERWRITE_OLDEST) {
+            meta->usart_error = USART_BUFOVF_bm;            // Byte dropped; flag the next stored one
+            return;
+        }
+        uint8_t status_oldest;
+        meta->rb_rx.out++;                                  // Drop oldest; flag the new oldest
+        status_oldest = (rx_status_get(meta, meta->rb_rx.out) >> 8) | USART_BUFOVF_bm;
+        rx_status_put(meta, meta->rb_rx.out, USART_RX_STATUS_PACK(status_oldest));
+    }
+    status |= meta->usart_error;                            // Report earlier dropped bytes here
+    meta->usart_error = 0;
+    rx_status_put(meta, meta->rb_rx.in, USART_RX_STATUS_PACK(status));
+    rbuffer_insert(data, &meta->rb_rx);
+#ifdef USART_RTSCTS
+    if (meta->fc_port && (rbuffer_count(&meta->rb_rx) >= meta->rx_high)) {
+        meta->fc_port->OUTSET = meta->rts_pin;              // Deassert RTS above high watermark
+    }
+#endif
+#ifdef USART_XONXOFF
+    if (meta->xonxoff && !meta->rx_stopped && (rbuffer_count(&meta->rb_rx) >= meta->rx_high)) {
+        meta->rx_stopped = 1;
+        meta->x_pending = USART_XOFF;                       // Sent ahead of queued data
+        usart->CTRLA |= USART_DREIE_bm;
+    }
+#endif
 }
 
+// Drain the 2-level Rx FIFO in one ISR entry, saving a prologue/epilogue per byte
+static inline void isr_usart_rxc_vect(volatile usart_meta_t* meta) {
+    USART_t* const usart = meta->usart;
+    do {
+        isr_usart_rx_byte(meta, usart);
+    } while (usart->STATUS & USART_RXCIF_bm);
+}
+
+// A pause (CTS deasserted, XOFF received) only holds back data; the last byte already in
+// the shifter still ends through TXC, so tx_busy clears and usart_tx_done() can succeed
 static inline void isr_usart_dre_vect(volatile usart_meta_t* meta) {
-    if(!rbuffer_empty(&meta->rb_tx)) {
-        meta->usart->TXDATAL = rbuffer_remove(&meta->rb_tx);
+    USART_t* const usart = meta->usart;
+    bool paused = false;
+#ifdef USART_RTSCTS
+    paused = usart_cts_paused(meta);                        // usart_cts_isr() resumes
+#endif
+#ifdef USART_XONXOFF
+    if (meta->x_pending && !paused) {
+        usart_tx_put(meta, meta->x_pending);
+        meta->x_pending = 0;
+        return;
+    }
+    paused |= meta->tx_paused;                              // XON resumes
+#endif
+    if(!paused && !rbuffer_empty(&meta->rb_tx)) {
+        do {                                                // Refill TXDATA while the shifter starts
+            usart_tx_put(meta, rbuffer_remove(&meta->rb_tx));
+        } while ((usart->STATUS & USART_DREIF_bm) && !rbuffer_empty(&meta->rb_tx));
+    }
+    else if (meta->tx_busy) {
+        usart->CTRLA = (usart->CTRLA & ~USART_DREIE_bm) | USART_TXCIE_bm;
     }
     else {
-        meta->usart->CTRLA &= ~USART_DREIE_bm;
+        usart->CTRLA &= ~USART_DREIE_bm;
+    }
+}
+
+static inline void isr_usart_txc_vect(volatile usart_meta_t* meta) {
+    USART_t* const usart = meta->usart;
+    usart->CTRLA &= ~USART_TXCIE_bm;                        // TXCIF stays set until next byte
+    meta->tx_busy = 0;
+    if (meta->tx_done) {
+        meta->tx_done(meta);
+    }
+    if (meta->closing && rbuffer_empty(&meta->rb_tx)) {    // usart_close_async() pending
+        usart_shutdown(meta);
+        if (meta->closed) {
+            meta->closed(meta);
+        }
     }
 }
 
@@ -255,6 +1153,9 @@ ISR(USART0_RXC_vect) {
 ISR(USART0_DRE_vect) {
     isr_usart_dre_vect(&usart0);
 }
+ISR(USART0_TXC_vect) {
+    isr_usart_txc_vect(&usart0);
+}
 #endif
 
 #ifdef USART1_ENABLE
@@ -264,6 +1165,9 @@ ISR(USART1_RXC_vect) {
 ISR(USART1_DRE_vect) {
     isr_usart_dre_vect(&usart1);
 }
+ISR(USART1_TXC_vect) {
+    isr_usart_txc_vect(&usart1);
+}
 #endif
 
 #ifdef USART2_ENABLE
@@ -273,6 +1177,9 @@ ISR(USART2_RXC_vect) {
 ISR(USART2_DRE_vect) {
     isr_usart_dre_vect(&usart2);
 }
+ISR(USART2_TXC_vect) {
+    isr_usart_txc_vect(&usart2);
+}
 #endif
 
 #ifdef USART3_ENABLE
@@ -282,6 +1189,9 @@ ISR(USART3_RXC_vect) {
 ISR(USART3_DRE_vect) {
     isr_usart_dre_vect(&usart3);
 }
+ISR(USART3_TXC_vect) {
+    isr_usart_txc_vect(&usart3);
+}
 #endif
 
 #ifdef USART4_ENABLE
@@ -291,6 +1201,9 @@ ISR(USART4_RXC_vect) {
 ISR(USART4_DRE_vect) {
     isr_usart_dre_vect(&usart4);
 }
+ISR(USART4_TXC_vect) {
+    isr_usart_txc_vect(&usart4);
+}
 #endif
 
 #ifdef USART5_ENABLE
@@ -300,6 +1213,9 @@ ISR(USART5_RXC_vect) {
 ISR(USART5_DRE_vect) {
     isr_usart_dre_vect(&usart5);
 }
+ISR(USART5_TXC_vect) {
+    isr_usart_txc_vect(&usart5);
+}
 #endif
 
 #ifdef USART6_ENABLE
@@ -309,6 +1225,9 @@ ISR(USART6_RXC_vect) {
 ISR(USART6_DRE_vect) {
     isr_usart_dre_vect(&usart6);
 }
+ISR(USART6_TXC_vect) {
+    isr_usart_txc_vect(&usart6);
+}
 #endif
 
 #ifdef USART7_ENABLE
@@ -318,4 +1237,7 @@ ISR(USART7_RXC_vect) {
 ISR(USART7_DRE_vect) {
     isr_usart_dre_vect(&usart7);
 }
+ISR(USART7_TXC_vect) {
+    isr_usart_txc_vect(&usart7);
+}
 #endif
\ No newline at end of file
@@ -8,14 +8,29 @@
  *          Version:      RC1
  */
 
+#ifndef UART_H
+#define UART_H
+
 #include <avr/io.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
-// DEFINE RING BUFFER SIZE; MUST BE 2, 4, 8, 16, 32, 64 or 128
+// DEFINE DEFAULT RING BUFFER SIZE; MUST BE A POWER OF 2 FROM 2 TO 32768
+// SIZES UP TO 128 USE 8-BIT INDICES, LARGER SIZES SWITCH ALL BUFFERS TO 16-BIT
 #define RBUFFER_SIZE 32  
 
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// UNCOMMENT TO OVERRIDE Rx/Tx RING BUFFER SIZE PER USARTn (SAME RULES AS ABOVE)
+// SIZE 0 ALLOCATES NO STORAGE; IT MUST THEN BE BOUND WITH usart_set_buffer()
+// #define USART0_RX_BUFFER_SIZE 128
+// #define USART0_TX_BUFFER_SIZE 8
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// UNCOMMENT TO FORCE 16-BIT INDICES (FOR usart_set_buffer() STORAGE > 128)
+// #define RBUFFER_INDEX16
+
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 // UNCOMMENT TO ENABLE USARTn
 #define USART0_ENABLE
@@ -32,26 +47,226 @@
 #define USART_STREAM
 
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
-#define USART_BUFFER_OVERFLOW    0x6400      // ==USART_BUFOVF_bm
+// UNCOMMENT TO ENABLE RTS/CTS HARDWARE FLOW CONTROL (usart_set_rtscts())
+// #define USART_RTSCTS
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// UNCOMMENT TO ENABLE XON/XOFF SOFTWARE FLOW CONTROL (usart_set_xonxoff())
+// #define USART_XONXOFF
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// UNCOMMENT TO ENABLE 9-BIT MULTIPROCESSOR COMMUNICATION MODE (usart_set_mpcm())
+// #define USART_MPCM
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// UNCOMMENT TO ENABLE AUTO-BAUD DETECTION (usart_autobaud())
+// #define USART_AUTOBAUD
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// UNCOMMENT TO ENABLE THE LIN FRAME ENGINE IN lin.c (IMPLIES USART_AUTOBAUD)
+// #define USART_LIN
+
+#if defined(USART_LIN) && !defined(USART_AUTOBAUD)
+#define USART_AUTOBAUD
+#endif
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// UNCOMMENT TO ENABLE START-OF-FRAME WAKEUP FROM STANDBY (usart_sleep_until_rx())
+// #define USART_SFD
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// RING BUFFER SIZE DEFAULTS
+#ifndef USART0_RX_BUFFER_SIZE
+#define USART0_RX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART0_RX_BUFFER_SIZE > 32768) || (USART0_RX_BUFFER_SIZE & (USART0_RX_BUFFER_SIZE - 1)) || (USART0_RX_BUFFER_SIZE == 1)
+#error "USART0_RX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART0_TX_BUFFER_SIZE
+#define USART0_TX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART0_TX_BUFFER_SIZE > 32768) || (USART0_TX_BUFFER_SIZE & (USART0_TX_BUFFER_SIZE - 1)) || (USART0_TX_BUFFER_SIZE == 1)
+#error "USART0_TX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART1_RX_BUFFER_SIZE
+#define USART1_RX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART1_RX_BUFFER_SIZE > 32768) || (USART1_RX_BUFFER_SIZE & (USART1_RX_BUFFER_SIZE - 1)) || (USART1_RX_BUFFER_SIZE == 1)
+#error "USART1_RX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART1_TX_BUFFER_SIZE
+#define USART1_TX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART1_TX_BUFFER_SIZE > 32768) || (USART1_TX_BUFFER_SIZE & (USART1_TX_BUFFER_SIZE - 1)) || (USART1_TX_BUFFER_SIZE == 1)
+#error "USART1_TX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART2_RX_BUFFER_SIZE
+#define USART2_RX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART2_RX_BUFFER_SIZE > 32768) || (USART2_RX_BUFFER_SIZE & (USART2_RX_BUFFER_SIZE - 1)) || (USART2_RX_BUFFER_SIZE == 1)
+#error "USART2_RX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART2_TX_BUFFER_SIZE
+#define USART2_TX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART2_TX_BUFFER_SIZE > 32768) || (USART2_TX_BUFFER_SIZE & (USART2_TX_BUFFER_SIZE - 1)) || (USART2_TX_BUFFER_SIZE == 1)
+#error "USART2_TX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART3_RX_BUFFER_SIZE
+#define USART3_RX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART3_RX_BUFFER_SIZE > 32768) || (USART3_RX_BUFFER_SIZE & (USART3_RX_BUFFER_SIZE - 1)) || (USART3_RX_BUFFER_SIZE == 1)
+#error "USART3_RX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART3_TX_BUFFER_SIZE
+#define USART3_TX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART3_TX_BUFFER_SIZE > 32768) || (USART3_TX_BUFFER_SIZE & (USART3_TX_BUFFER_SIZE - 1)) || (USART3_TX_BUFFER_SIZE == 1)
+#error "USART3_TX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART4_RX_BUFFER_SIZE
+#define USART4_RX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART4_RX_BUFFER_SIZE > 32768) || (USART4_RX_BUFFER_SIZE & (USART4_RX_BUFFER_SIZE - 1)) || (USART4_RX_BUFFER_SIZE == 1)
+#error "USART4_RX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART4_TX_BUFFER_SIZE
+#define USART4_TX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART4_TX_BUFFER_SIZE > 32768) || (USART4_TX_BUFFER_SIZE & (USART4_TX_BUFFER_SIZE - 1)) || (USART4_TX_BUFFER_SIZE == 1)
+#error "USART4_TX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART5_RX_BUFFER_SIZE
+#define USART5_RX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART5_RX_BUFFER_SIZE > 32768) || (USART5_RX_BUFFER_SIZE & (USART5_RX_BUFFER_SIZE - 1)) || (USART5_RX_BUFFER_SIZE == 1)
+#error "USART5_RX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART5_TX_BUFFER_SIZE
+#define USART5_TX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART5_TX_BUFFER_SIZE > 32768) || (USART5_TX_BUFFER_SIZE & (USART5_TX_BUFFER_SIZE - 1)) || (USART5_TX_BUFFER_SIZE == 1)
+#error "USART5_TX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART6_RX_BUFFER_SIZE
+#define USART6_RX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART6_RX_BUFFER_SIZE > 32768) || (USART6_RX_BUFFER_SIZE & (USART6_RX_BUFFER_SIZE - 1)) || (USART6_RX_BUFFER_SIZE == 1)
+#error "USART6_RX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART6_TX_BUFFER_SIZE
+#define USART6_TX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART6_TX_BUFFER_SIZE > 32768) || (USART6_TX_BUFFER_SIZE & (USART6_TX_BUFFER_SIZE - 1)) || (USART6_TX_BUFFER_SIZE == 1)
+#error "USART6_TX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART7_RX_BUFFER_SIZE
+#define USART7_RX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART7_RX_BUFFER_SIZE > 32768) || (USART7_RX_BUFFER_SIZE & (USART7_RX_BUFFER_SIZE - 1)) || (USART7_RX_BUFFER_SIZE == 1)
+#error "USART7_RX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+#ifndef USART7_TX_BUFFER_SIZE
+#define USART7_TX_BUFFER_SIZE RBUFFER_SIZE
+#endif
+#if (USART7_TX_BUFFER_SIZE > 32768) || (USART7_TX_BUFFER_SIZE & (USART7_TX_BUFFER_SIZE - 1)) || (USART7_TX_BUFFER_SIZE == 1)
+#error "USART7_TX_BUFFER_SIZE MUST BE 0 OR A POWER OF 2 FROM 2 TO 32768"
+#endif
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// RING BUFFER INDEX WIDTH; 16-BIT ONLY IF AN ENABLED BUFFER IS LARGER THAN 128
+#if defined(USART0_ENABLE) && ((USART0_RX_BUFFER_SIZE > 128) || (USART0_TX_BUFFER_SIZE > 128))
+#define RBUFFER_INDEX16
+#endif
+#if defined(USART1_ENABLE) && ((USART1_RX_BUFFER_SIZE > 128) || (USART1_TX_BUFFER_SIZE > 128))
+#define RBUFFER_INDEX16
+#endif
+#if defined(USART2_ENABLE) && ((USART2_RX_BUFFER_SIZE > 128) || (USART2_TX_BUFFER_SIZE > 128))
+#define RBUFFER_INDEX16
+#endif
+#if defined(USART3_ENABLE) && ((USART3_RX_BUFFER_SIZE > 128) || (USART3_TX_BUFFER_SIZE > 128))
+#define RBUFFER_INDEX16
+#endif
+#if defined(USART4_ENABLE) && ((USART4_RX_BUFFER_SIZE > 128) || (USART4_TX_BUFFER_SIZE > 128))
+#define RBUFFER_INDEX16
+#endif
+#if defined(USART5_ENABLE) && ((USART5_RX_BUFFER_SIZE > 128) || (USART5_TX_BUFFER_SIZE > 128))
+#define RBUFFER_INDEX16
+#endif
+#if defined(USART6_ENABLE) && ((USART6_RX_BUFFER_SIZE > 128) || (USART6_TX_BUFFER_SIZE > 128))
+#define RBUFFER_INDEX16
+#endif
+#if defined(USART7_ENABLE) && ((USART7_RX_BUFFER_SIZE > 128) || (USART7_TX_BUFFER_SIZE > 128))
+#define RBUFFER_INDEX16
+#endif
+
+#include "rbuffer.h"
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+#define USART_BUFFER_OVERFLOW    0x4000      // ==USART_BUFOVF_bm
 #define USART_FRAME_ERROR        0x0400      // ==USART_FERR_bm
 #define USART_PARITY_ERROR       0x0200      // ==USART_PERR_bm
 #define USART_NO_DATA            0x0100      
 
+#define USART_XON                0x11
+#define USART_XOFF               0x13
+
+#define USART_MPCM_OFF           0
+#define USART_MPCM_MASTER        1
+#define USART_MPCM_SLAVE         2
+#define USART_MPCM_BROADCAST     0xFF
+
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
-#define BAUD_RATE(BAUD_RATE) ((float)(F_CPU * 64 / (16 * (float)BAUD_RATE)) + 0.5)
+// Rx OVERFLOW POLICY WHEN rb_rx IS FULL
+#define USART_RX_DROP_NEWEST       0        // Discard the incoming byte (default)
+#define USART_RX_OVERWRITE_OLDEST  1        // Discard the oldest byte; latest sample wins
 
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
-// RINGBUFFER STRUCT
-typedef struct { 
-    volatile char     buffer[RBUFFER_SIZE];
-    volatile uint8_t  in;
-    volatile uint8_t  out;
-    volatile uint8_t  count;
-} ringbuffer_t;
+// BAUD CORRECTION FROM FACTORY OSC16ERR/OSC20ERR IN SIGROW (OSC20M MAIN CLOCK ONLY)
+#define USART_OSC_CAL_OFF          0        // No correction (default)
+#define USART_OSC_CAL_3V           1        // Error measured at 3V
+#define USART_OSC_CAL_5V           2        // Error measured at 5V
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// Rx STATUS BYTES FOR A RING OF 'size'; ONE ERROR NIBBLE PER BYTE
+#define USART_RX_STATUS_SIZE(size) (((size) + 1) / 2)
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// BAUD REGISTER, INTEGER MATH AT COMPILE TIME; 'rate' must be a constant expression.
+// USART_BAUD() uses normal mode (BAUD = 4*F_CPU/rate) unless only CLK2X (BAUD =
+// 8*F_CPU/rate) reaches the rate. USART_INIT_BAUD() applies both mode and BAUD;
+// with USART_BAUD() alone, USART_RXMODE(rate) must go to usart_set_rxmode() first.
+// The build fails when BAUD is below 64, does not fit 16 bits or is off by more
+// than USART_BAUD_TOLERANCE
+#ifndef USART_BAUD_TOLERANCE
+#define USART_BAUD_TOLERANCE     5          // Max rounding error in per mille
+#endif
+
+#define USART_BAUD_SCALE(rate)          ((4UL * (F_CPU) >= 64UL * (rate)) ? 4UL : 8UL)
+#define USART_BAUD_VALUE(rate, scale)   (((scale) * (F_CPU) + (rate) / 2) / (rate))
+#define USART_BAUD_DIFF(rate, scale)    ((USART_BAUD_VALUE(rate, scale) * (rate) > (scale) * (F_CPU)) ?    \
+                                         (USART_BAUD_VALUE(rate, scale) * (rate) - (scale) * (F_CPU)) :    \
+                                         ((scale) * (F_CPU) - USART_BAUD_VALUE(rate, scale) * (rate)))
+#define USART_BAUD_ASSERT(cond, msg)    sizeof(struct { _Static_assert(cond, msg); char c; })
+
+#define USART_BAUD_CHECKED(rate, scale) ((uint16_t)(USART_BAUD_VALUE(rate, scale) + 0 *                         \
+    USART_BAUD_ASSERT(USART_BAUD_VALUE(rate, scale) >= 64UL, "Baud rate too high for F_CPU in this RXMODE") *    \
+    USART_BAUD_ASSERT(USART_BAUD_VALUE(rate, scale) <= 0xFFFFUL, "BAUD overflows 16 bits; baud rate too low") * \
+    USART_BAUD_ASSERT(USART_BAUD_DIFF(rate, scale) * 1000ULL <= USART_BAUD_TOLERANCE * (scale) * (F_CPU),      \
+                      "Baud rate error exceeds USART_BAUD_TOLERANCE")))
+
+#define USART_BAUD(rate)         USART_BAUD_CHECKED(rate, USART_BAUD_SCALE(rate))
+#define USART_RXMODE(rate)       ((USART_BAUD_SCALE(rate) == 4UL) ? USART_RXMODE_NORMAL_gc : USART_RXMODE_CLK2X_gc)
+#define USART_INIT_BAUD(meta, rate)     (usart_set_rxmode(meta, USART_RXMODE(rate)), usart_init(meta, USART_BAUD(rate)))
+
+// Fixed mode; USART_BAUD_2X() with usart_set_rxmode(meta, USART_RXMODE_CLK2X_gc)
+#define USART_BAUD_2X(rate)      USART_BAUD_CHECKED(rate, 8UL)
+#define BAUD_RATE(rate)          USART_BAUD_CHECKED(rate, 4UL)
 
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 // USART META STRUCT
-typedef struct { 
+typedef struct usart_meta usart_meta_t;
+struct usart_meta { 
     USART_t* usart;                 // USART device ptr
     PORT_t*  port;                  // PORT device ptr
     register8_t* pmuxr;             // PORTMUX.USARTROUTE A B ptr
@@ -60,19 +275,105 @@ typedef struct {
     uint8_t tx_pin;                 // Tx PIN bm
     volatile ringbuffer_t rb_rx;    // Rx ringbuffer
     volatile ringbuffer_t rb_tx;    // Tx ringbuffer
-    volatile uint8_t usart_error;   // Holds error from RXDATAH
-} usart_meta_t;
+    volatile uint8_t* rx_status;    // Rx error nibble per rb_rx slot
+    volatile uint8_t usart_error;   // Pending overflow for next stored byte
+    uint8_t rx_policy;              // Rx overflow policy
+    volatile uint16_t rx_dropped;   // Rx bytes lost since usart_init()
+    uint8_t rxmode;                 // CTRLB RXMODE gc (normal or CLK2X)
+    uint8_t format;                 // CTRLC PMODE, SBMODE, CHSIZE gc
+    uint8_t osc_cal;                // USART_OSC_CAL_OFF, _3V or _5V
+    uint8_t rs485;                  // CTRLA RS485 mode gc
+    uint8_t xdir_pin;               // XDIR PIN bm (RS485 EXT)
+    volatile uint8_t tx_busy;       // Last byte not yet shifted out
+    void (*tx_done)(volatile usart_meta_t* meta);   // TXC notification, NULL if unused
+    volatile uint8_t closing;       // usart_close_async() pending
+    void (*closed)(volatile usart_meta_t* meta);    // Async close notification, NULL if unused
+#if defined(USART_RTSCTS) || defined(USART_XONXOFF)
+    rbuffer_index_t rx_high;        // Stop sender at/above this rb_rx count
+    rbuffer_index_t rx_low;         // Resume sender at/below this rb_rx count
+#endif
+#ifdef USART_RTSCTS
+    PORT_t* fc_port;                // RTS/CTS PORT ptr, NULL if unused
+    uint8_t rts_pin;                // RTS output PIN bm
+    uint8_t cts_pin;                // CTS input PIN bm
+#endif
+#ifdef USART_XONXOFF
+    uint8_t xonxoff;                // XON/XOFF enabled
+    volatile uint8_t tx_paused;     // Peer sent XOFF
+    volatile uint8_t rx_stopped;    // We sent XOFF
+    volatile char x_pending;        // XON/XOFF to send next, 0 if none
+#endif
+#ifdef USART_MPCM
+    uint8_t mpcm;                   // USART_MPCM_OFF, _MASTER or _SLAVE
+    uint8_t mpcm_address;           // Own address (slave)
+#endif
+#ifdef USART_AUTOBAUD
+    volatile uint16_t baud_measured;    // BAUD from last break + sync, 0 if none
+    uint16_t baud_armed;            // BAUD before the pending measurement
+    volatile uint8_t brk_seen;      // BDF seen at a start bit, reported with that byte
+#endif
+#ifdef USART_LIN
+    struct lin* lin;                // LIN engine owning this USART, NULL if none
+#endif
+};
 
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 // USART FUNCTIONS
 void usart_set(volatile usart_meta_t* meta, PORT_t*  port, uint8_t route, uint8_t tx_pin, uint8_t rx_pin);
-void usart_init(volatile usart_meta_t* meta, uint16_t baud_rate);
+bool usart_set_buffer(volatile usart_meta_t* meta, char* rx_buffer, uint16_t rx_size, uint8_t* rx_status, char* tx_buffer, uint16_t tx_size);
+void usart_set_rx_policy(volatile usart_meta_t* meta, uint8_t policy);
+void usart_set_rxmode(volatile usart_meta_t* meta, uint8_t rxmode_gc);
+bool usart_set_format(volatile usart_meta_t* meta, uint8_t format);
+void usart_set_osc_cal(volatile usart_meta_t* meta, uint8_t osc_cal);
+void usart_set_rs485(volatile usart_meta_t* meta, uint8_t rs485_gc, uint8_t xdir_pin);
+void usart_set_tx_done(volatile usart_meta_t* meta, void (*tx_done)(volatile usart_meta_t* meta));
+bool usart_init(volatile usart_meta_t* meta, uint16_t baud_rate);
 void usart_send_char(volatile usart_meta_t* meta, char c);
 void usart_send_string(volatile usart_meta_t* meta, const char* str);
 void usart_send_string_P(volatile usart_meta_t* meta, const char* chr);
-uint8_t usart_rx_count(volatile usart_meta_t* meta);
+rbuffer_index_t usart_tx_reserve(volatile usart_meta_t* meta, char** data);
+void usart_tx_commit(volatile usart_meta_t* meta, rbuffer_index_t n);
+size_t usart_write(volatile usart_meta_t* meta, const void* data, size_t len);
+uint8_t usart_try_send_char(volatile usart_meta_t* meta, char c);
+size_t usart_try_send_string(volatile usart_meta_t* meta, const char* str);
+size_t usart_try_write(volatile usart_meta_t* meta, const void* data, size_t len);
+rbuffer_index_t usart_tx_free(volatile usart_meta_t* meta);
+rbuffer_index_t usart_rx_count(volatile usart_meta_t* meta);
 uint16_t usart_read_char(volatile usart_meta_t* meta);
+uint16_t usart_rx_error(volatile usart_meta_t* meta, rbuffer_index_t offset);
+uint16_t usart_rx_dropped(volatile usart_meta_t* meta);
+size_t usart_read(volatile usart_meta_t* meta, void* data, size_t len);
+rbuffer_index_t usart_rx_peek(volatile usart_meta_t* meta, const char** data);
+void usart_rx_consume(volatile usart_meta_t* meta, rbuffer_index_t n);
+bool usart_tx_done(volatile usart_meta_t* meta);
+bool usart_change_format(volatile usart_meta_t* meta, uint8_t format);
 void usart_close(volatile usart_meta_t* meta);
+void usart_close_async(volatile usart_meta_t* meta, void (*closed)(volatile usart_meta_t* meta));
+bool usart_set_clock(uint8_t mclkctrlb, uint32_t f_clk);
+
+#ifdef USART_RTSCTS
+void usart_set_rtscts(volatile usart_meta_t* meta, PORT_t* port, uint8_t rts_pin, uint8_t cts_pin);
+void usart_cts_isr(volatile usart_meta_t* meta);
+#endif
+
+#ifdef USART_XONXOFF
+void usart_set_xonxoff(volatile usart_meta_t* meta, bool enable);
+#endif
+
+#ifdef USART_MPCM
+void usart_set_mpcm(volatile usart_meta_t* meta, uint8_t mode, uint8_t address);
+void usart_send_address(volatile usart_meta_t* meta, uint8_t address);
+#endif
+
+#ifdef USART_AUTOBAUD
+void usart_autobaud(volatile usart_meta_t* meta, uint8_t rxmode_gc);
+uint16_t usart_autobaud_result(volatile usart_meta_t* meta);
+void usart_rxd_isr(volatile usart_meta_t* meta);
+#endif
+
+#ifdef USART_SFD
+void usart_sleep_until_rx(volatile usart_meta_t* meta);
+#endif
 
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 // usart_meta_t
@@ -152,4 +453,6 @@ void usart_close(volatile usart_meta_t* meta);
     extern volatile usart_meta_t usart7;
     #endif
 
-#endif
\ No newline at end of file
+#endif
+
+#endif